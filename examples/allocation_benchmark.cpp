@@ -0,0 +1,102 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+
+#include <signum/circular_buffer.hpp>
+
+namespace po = boost::program_options;
+namespace cb = signum::circular_buffer;
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+using microseconds = std::chrono::duration<double, std::micro>;
+using nanoseconds = std::chrono::duration<double, std::nano>;
+
+//! Returns the mean time to construct and destroy a buffer
+double construction(size_t bytes, size_t repetitions, const cb::options & opts)
+{
+    const auto start = clock_type::now();
+
+    for (size_t n = 0; n < repetitions; ++n)
+    {
+        auto wr = cb::writer<uint8_t>(bytes - 1, opts);
+        (void) wr;
+    }
+
+    const microseconds elapsed = clock_type::now() - start;
+
+    return elapsed.count() / repetitions;
+}
+
+//! Returns the mean time to fault in a page when first written
+double first_touch(size_t bytes, size_t page_size, const cb::options & opts)
+{
+    auto wr = cb::writer<uint8_t>(bytes - 1, opts);
+    auto rd = wr.make_reader();
+
+    const auto size = wr.size();
+    auto begin = wr.begin();
+
+    const auto start = clock_type::now();
+
+    for (size_t n = 0; n < size; n += page_size)
+        begin[n] = 1;
+
+    const nanoseconds elapsed = clock_type::now() - start;
+
+    return elapsed.count() / ((size + page_size - 1) / page_size);
+}
+} // namespace (anonymous)
+
+int main(int argc, char *argv[])
+{
+    size_t minimum;
+    size_t maximum;
+    size_t repetitions;
+
+    po::options_description desc("Supported options");
+    desc.add_options()
+        ("help,h", "print help message")
+        ("min", po::value<size_t>(&minimum)->default_value(64 << 10), "set minimum buffer size in bytes")
+        ("max", po::value<size_t>(&maximum)->default_value(1 << 30), "set maximum buffer size in bytes")
+        ("repetitions,r", po::value<size_t>(&repetitions)->default_value(100), "set number of constructions per size")
+        ("huge", "back buffers with 2 MiB huge pages if available");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    cb::options opts;
+    if (vm.count("huge"))
+        opts.pages = cb::page_sizes::huge_2mb;
+
+    const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    std::cout << std::setw(12) << "bytes"
+              << std::setw(20) << "construction (us)"
+              << std::setw(20) << "first touch (ns)" << std::endl;
+
+    for (auto bytes = minimum; bytes <= maximum; bytes *= 4)
+    {
+        std::cout << std::setw(12) << bytes
+                  << std::setw(20) << construction(bytes, repetitions, opts)
+                  << std::setw(20) << first_touch(bytes, page_size, opts) << std::endl;
+    }
+
+    return 0;
+}
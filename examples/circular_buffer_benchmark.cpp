@@ -0,0 +1,194 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+
+#include <signum/circular_buffer.hpp>
+
+namespace po = boost::program_options;
+namespace cb = signum::circular_buffer;
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+
+double throughput(size_t length, size_t block, size_t items, const cb::options & opts)
+{
+    auto wr = cb::writer<float>(length, opts);
+    auto rd = wr.make_reader();
+
+    const auto start = clock_type::now();
+
+    std::thread producer([&]{
+        for (size_t n = 0; n < items; n += block)
+        {
+            const auto count = std::min(block, items - n);
+            wr.wait(count);
+            std::fill_n(wr.begin(), count, static_cast<float>(n));
+            wr.consume(count);
+        }
+    });
+
+    for (size_t n = 0; n < items; n += block)
+    {
+        const auto count = std::min(block, items - n);
+        rd.wait(count);
+        rd.consume(count);
+    }
+
+    producer.join();
+
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+
+    return items / elapsed.count();
+}
+
+double overhead(size_t iterations)
+{
+    auto wr = cb::writer<float>();
+    auto rd = wr.make_reader();
+
+    const auto start = clock_type::now();
+
+    for (size_t n = 0; n < iterations; ++n)
+    {
+        wr.consume(1);
+        rd.consume(1);
+    }
+
+    const std::chrono::duration<double, std::nano> elapsed = clock_type::now() - start;
+
+    // Each iteration is one update on each side
+    return elapsed.count() / (2 * iterations);
+}
+
+double latency(size_t iterations, const cb::options & opts)
+{
+    auto ping = cb::writer<uint64_t>(1, opts);
+    auto ping_rd = ping.make_reader();
+    auto pong = cb::writer<uint64_t>(1, opts);
+    auto pong_rd = pong.make_reader();
+
+    std::thread echo([&]{
+        for (size_t n = 0; n < iterations; ++n)
+        {
+            ping_rd.wait(1);
+            const auto value = *ping_rd.begin();
+            ping_rd.consume(1);
+            *pong.begin() = value;
+            pong.consume(1);
+        }
+    });
+
+    const auto start = clock_type::now();
+
+    for (size_t n = 0; n < iterations; ++n)
+    {
+        *ping.begin() = n;
+        ping.consume(1);
+        pong_rd.wait(1);
+        pong_rd.consume(1);
+    }
+
+    const std::chrono::duration<double, std::nano> elapsed = clock_type::now() - start;
+
+    echo.join();
+
+    // Each iteration is two handoffs
+    return elapsed.count() / (2 * iterations);
+}
+
+double first_write(size_t length, const cb::options & opts)
+{
+    const size_t stride = sysconf(_SC_PAGESIZE) / sizeof(float);
+
+    auto wr = cb::writer<float>(length, opts);
+
+    // The first write to a page that is not locked takes a page fault
+    auto worst = clock_type::duration::zero();
+    for (size_t n = 0; n < wr.size(); n += stride)
+    {
+        const auto start = clock_type::now();
+        wr.begin()[n] = static_cast<float>(n);
+        worst = std::max(worst, clock_type::now() - start);
+    }
+
+    return std::chrono::duration<double, std::micro>(worst).count();
+}
+} // namespace (anonymous)
+
+int main(int argc, char *argv[])
+{
+    size_t length;
+    size_t block;
+    size_t items;
+    size_t iterations;
+    std::string mode;
+    cb::options opts;
+
+    po::options_description desc("Supported options");
+    desc.add_options()
+        ("help,h", "print help message")
+        ("length,l", po::value<size_t>(&length)->default_value(65536), "set buffer length in items")
+        ("block,b", po::value<size_t>(&block)->default_value(512), "set block size in items")
+        ("items,n", po::value<size_t>(&items)->default_value(100000000), "set number of items to transfer")
+        ("iterations,i", po::value<size_t>(&iterations)->default_value(100000), "set number of latency round trips")
+        ("wait,w", po::value<std::string>(&mode)->default_value("block"), "set wait mode (block, spin or poll)")
+        ("spins,s", po::value<unsigned>(&opts.wait.spins)->default_value(1000), "set polls before sleeping in spin mode");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    if (mode == "block")
+        opts.wait.mode = cb::wait_modes::block;
+    else if (mode == "spin")
+        opts.wait.mode = cb::wait_modes::spin;
+    else if (mode == "poll")
+        opts.wait.mode = cb::wait_modes::poll;
+    else
+    {
+        std::cerr << "Unknown wait mode " << mode << std::endl;
+        return 1;
+    }
+
+    if (block == 0 || block > length)
+    {
+        std::cerr << "Block size must be nonzero and no larger than the buffer" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Throughput: " << throughput(length, block, items, opts) << " items/s" << std::endl;
+    std::cout << "Update overhead: " << overhead(iterations) << " ns" << std::endl;
+    std::cout << "Handoff latency: " << latency(iterations, opts) << " ns" << std::endl;
+
+    std::cout << "Worst first write: " << first_write(length, opts) << " us unlocked";
+    try
+    {
+        cb::options locked = opts;
+        locked.lock = true;
+        std::cout << ", " << first_write(length, locked) << " us locked" << std::endl;
+    }
+    catch (const std::runtime_error & error)
+    {
+        std::cout << ", " << error.what() << std::endl;
+    }
+
+    return 0;
+}
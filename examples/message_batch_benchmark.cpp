@@ -0,0 +1,94 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include <signum/ip/udp.hpp>
+#include <signum/message_batch.hpp>
+
+namespace po = boost::program_options;
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+using nanoseconds = std::chrono::duration<double, std::nano>;
+
+//! Returns the mean time to send each message in batches of a size
+double sending(signum::ip::udp & sock, size_t count, size_t batch_size)
+{
+    signum::message_batch batch(batch_size, std::chrono::milliseconds(1));
+    signum::message msg;
+
+    const auto start = clock_type::now();
+
+    for (size_t n = 0; n < count; ++n)
+    {
+        msg.clear();
+        msg << static_cast<uint32_t>(n) << 915e6 << -3.5f;
+
+        if (!batch.append(msg))
+        {
+            sock.send(batch.data(), batch.size());
+            batch.clear();
+            batch.append(msg);
+        }
+
+        if (batch.expired())
+        {
+            sock.send(batch.data(), batch.size());
+            batch.clear();
+        }
+    }
+
+    if (!batch.empty())
+        sock.send(batch.data(), batch.size());
+
+    const nanoseconds elapsed = clock_type::now() - start;
+
+    return elapsed.count() / count;
+}
+} // namespace (anonymous)
+
+int main(int argc, char *argv[])
+{
+    size_t count;
+    std::string host;
+    uint16_t port;
+
+    po::options_description desc("Supported options");
+    desc.add_options()
+        ("help,h", "print help message")
+        ("count,c", po::value<size_t>(&count)->default_value(100000), "set number of messages")
+        ("host", po::value<std::string>(&host)->default_value("127.0.0.1"), "set destination address")
+        ("port,p", po::value<uint16_t>(&port)->default_value(9999), "set destination port");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    signum::ip::udp sock(host, port);
+
+    std::cout << std::setw(12) << "batch bytes"
+              << std::setw(20) << "per message (ns)" << std::endl;
+
+    // The smallest batch holds a single message
+    for (size_t size : { 32, 512, 8192, 65000 })
+    {
+        std::cout << std::setw(12) << size
+                  << std::setw(20) << sending(sock, count, size) << std::endl;
+    }
+
+    return 0;
+}
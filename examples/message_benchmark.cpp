@@ -0,0 +1,268 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <signum/message.hpp>
+
+namespace po = boost::program_options;
+
+namespace
+{
+struct telemetry
+{
+    uint64_t time;
+    float power;
+    int16_t channel;
+    bool locked;
+    double frequency;
+};
+} // namespace (anonymous)
+
+SIGNUM_MESSAGE_FIELDS(telemetry, &telemetry::time, &telemetry::power,
+                      &telemetry::channel, &telemetry::locked, &telemetry::frequency)
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+using nanoseconds = std::chrono::duration<double, std::nano>;
+
+//! Returns a message of values of every encoded width of a type
+template<typename T>
+signum::message make_message(size_t count)
+{
+    std::mt19937_64 engine(1);
+    std::uniform_int_distribution<unsigned> bits(0, 8 * sizeof(T) - 1);
+
+    signum::message msg;
+    for (size_t n = 0; n < count; ++n)
+        msg << static_cast<T>(engine() >> (63 - bits(engine)));
+
+    return msg;
+}
+
+//! Returns a message of double precision values
+signum::message make_float_message(size_t count)
+{
+    signum::message msg;
+    for (size_t n = 0; n < count; ++n)
+        msg << static_cast<double>(n) / 3;
+
+    return msg;
+}
+
+//! Returns the mean time to deserialize each value of a message
+template<typename T>
+double deserialization(signum::message & msg, size_t count, size_t repetitions)
+{
+    T value = 0;
+    T sum = 0;
+
+    const auto start = clock_type::now();
+
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+        msg.reset();
+        for (size_t n = 0; n < count; ++n)
+        {
+            msg >> value;
+            sum += value;
+        }
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+
+    // Keep the values from being optimized away
+    volatile T sink = sum;
+    (void) sink;
+
+    return elapsed.count() / (count * repetitions);
+}
+
+//! Returns the mean time to reject a value of the wrong type by an exception
+double rejection(signum::message & msg, size_t repetitions)
+{
+    uint32_t value = 0;
+
+    const auto start = clock_type::now();
+
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+        msg.reset();
+        try
+        {
+            msg >> value;
+            return 0;
+        }
+        catch (const signum::message::deserialize_error &)
+        {
+        }
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+
+    return elapsed.count() / repetitions;
+}
+
+//! Returns the mean time to reject a value of the wrong type without throwing
+double try_rejection(signum::message & msg, size_t repetitions)
+{
+    uint32_t value = 0;
+
+    const auto start = clock_type::now();
+
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+        msg.reset();
+        if (msg.try_deserialize(value))
+            return 0;
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+
+    return elapsed.count() / repetitions;
+}
+
+//! Returns the mean time to serialize a struct field by field
+double field_serialization(size_t count, size_t repetitions)
+{
+    telemetry tm = { 123456789012, -3.5f, -7, true, 915e6 };
+    signum::message msg;
+
+    const auto start = clock_type::now();
+
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+        msg.clear();
+        for (size_t n = 0; n < count; ++n)
+        {
+            tm.time = n;
+            msg.serialize_array(5) << tm.time << tm.power << tm.channel
+                                   << tm.locked << tm.frequency;
+        }
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+
+    return elapsed.count() / (count * repetitions);
+}
+
+//! Returns the mean time to serialize a struct by its described fields
+double schema_serialization(size_t count, size_t repetitions)
+{
+    telemetry tm = { 123456789012, -3.5f, -7, true, 915e6 };
+    signum::message msg;
+
+    const auto start = clock_type::now();
+
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+        msg.clear();
+        for (size_t n = 0; n < count; ++n)
+        {
+            tm.time = n;
+            msg.serialize_fields(tm);
+        }
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+
+    return elapsed.count() / (count * repetitions);
+}
+
+//! Returns the mean time to deserialize a struct by its described fields
+double schema_deserialization(size_t count, size_t repetitions)
+{
+    telemetry tm = { 123456789012, -3.5f, -7, true, 915e6 };
+    signum::message msg;
+    for (size_t n = 0; n < count; ++n)
+        msg.serialize_fields(tm);
+
+    uint64_t sum = 0;
+
+    const auto start = clock_type::now();
+
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+        msg.reset();
+        for (size_t n = 0; n < count; ++n)
+        {
+            msg.deserialize_fields(tm);
+            sum += tm.time;
+        }
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+
+    volatile uint64_t sink = sum;
+    (void) sink;
+
+    return elapsed.count() / (count * repetitions);
+}
+} // namespace (anonymous)
+
+int main(int argc, char *argv[])
+{
+    size_t count;
+    size_t repetitions;
+
+    po::options_description desc("Supported options");
+    desc.add_options()
+        ("help,h", "print help message")
+        ("count,c", po::value<size_t>(&count)->default_value(4096), "set number of values per message")
+        ("repetitions,r", po::value<size_t>(&repetitions)->default_value(1000), "set number of passes over each message");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    auto u64 = make_message<uint64_t>(count);
+    auto u16 = make_message<uint16_t>(count);
+    auto s32 = make_message<int32_t>(count);
+    auto f64 = make_float_message(count);
+
+    std::cout << std::setw(12) << "type"
+              << std::setw(20) << "deserialize (ns)" << std::endl;
+
+    std::cout << std::setw(12) << "uint64"
+              << std::setw(20) << deserialization<uint64_t>(u64, count, repetitions) << std::endl;
+    std::cout << std::setw(12) << "uint16"
+              << std::setw(20) << deserialization<uint16_t>(u16, count, repetitions) << std::endl;
+    std::cout << std::setw(12) << "int32"
+              << std::setw(20) << deserialization<int32_t>(s32, count, repetitions) << std::endl;
+    std::cout << std::setw(12) << "float64"
+              << std::setw(20) << deserialization<double>(f64, count, repetitions) << std::endl;
+    std::cout << std::setw(12) << "rejected"
+              << std::setw(20) << rejection(f64, repetitions) << std::endl;
+    std::cout << std::setw(12) << "try"
+              << std::setw(20) << try_rejection(f64, repetitions) << std::endl;
+
+
+    std::cout << std::endl
+              << std::setw(12) << "struct"
+              << std::setw(20) << "serialize (ns)"
+              << std::setw(20) << "deserialize (ns)" << std::endl;
+
+    std::cout << std::setw(12) << "fields"
+              << std::setw(20) << field_serialization(count, repetitions)
+              << std::setw(20) << "-" << std::endl;
+    std::cout << std::setw(12) << "schema"
+              << std::setw(20) << schema_serialization(count, repetitions)
+              << std::setw(20) << schema_deserialization(count, repetitions) << std::endl;
+
+    return 0;
+}
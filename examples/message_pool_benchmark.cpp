@@ -0,0 +1,232 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <signum/message.hpp>
+#include <signum/message_pool.hpp>
+#ifdef SIGNUM_HAVE_ZEROMQ
+#include <signum/zeromq/socket.hpp>
+#endif
+
+namespace po = boost::program_options;
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+using nanoseconds = std::chrono::duration<double, std::nano>;
+
+//! The number of heap allocations made by the program
+std::atomic<size_t> allocations(0);
+
+//! The result of a run of messages
+struct result
+{
+    double time;        //!< mean nanoseconds per message
+    double allocations; //!< mean heap allocations per message
+};
+
+//! Fill a message as a sender would and read it back as a receiver would
+void exchange(signum::message & msg, std::vector<float> & block, uint32_t sequence)
+{
+    msg << sequence << 915e6;
+    msg.serialize(block.data(), block.size());
+
+    uint32_t sequence_r;
+    double frequency_r;
+    msg >> sequence_r >> frequency_r;
+    msg.deserialize(block.data(), block.size());
+}
+
+//! Run messages that are each constructed and destroyed
+result unpooled(size_t count, std::vector<float> & block)
+{
+    const auto before = allocations.load();
+    const auto start = clock_type::now();
+
+    for (size_t n = 0; n < count; ++n)
+    {
+        signum::message msg;
+        exchange(msg, block, n);
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+    const auto made = allocations.load() - before;
+
+    return result{elapsed.count() / count, static_cast<double>(made) / count};
+}
+
+//! Run messages that are acquired from a pool
+result pooled(signum::message_pool & pool, size_t count, std::vector<float> & block)
+{
+    const auto before = allocations.load();
+    const auto start = clock_type::now();
+
+    for (size_t n = 0; n < count; ++n)
+    {
+        auto msg = pool.acquire();
+        exchange(*msg, block, n);
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+    const auto made = allocations.load() - before;
+
+    return result{elapsed.count() / count, static_cast<double>(made) / count};
+}
+
+#ifdef SIGNUM_HAVE_ZEROMQ
+using signum::zeromq::socket;
+
+//! Send a request as a client would, then receive it and echo it as a server would
+void round_trip(socket & req, socket & rep, signum::message & request,
+                signum::message & received, std::vector<float> & block, uint32_t sequence)
+{
+    request << sequence << 915e6;
+    request.serialize(block.data(), block.size());
+    req.send(request);
+
+    rep.recv(received);
+    uint32_t sequence_r;
+    double frequency_r;
+    received >> sequence_r >> frequency_r;
+    received.deserialize(block.data(), block.size());
+
+    rep.send(received);
+    req.recv(request);
+}
+
+//! Run round trips with messages that are each constructed and destroyed
+result unpooled(socket & req, socket & rep, size_t count, std::vector<float> & block)
+{
+    const auto before = allocations.load();
+    const auto start = clock_type::now();
+
+    for (size_t n = 0; n < count; ++n)
+    {
+        signum::message request, received;
+        round_trip(req, rep, request, received, block, n);
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+    const auto made = allocations.load() - before;
+
+    return result{elapsed.count() / count, static_cast<double>(made) / count};
+}
+
+//! Run round trips with messages that are acquired from a pool
+result pooled(signum::message_pool & pool, socket & req, socket & rep,
+              size_t count, std::vector<float> & block)
+{
+    const auto before = allocations.load();
+    const auto start = clock_type::now();
+
+    for (size_t n = 0; n < count; ++n)
+    {
+        auto request = pool.acquire();
+        auto received = pool.acquire();
+        round_trip(req, rep, *request, *received, block, n);
+    }
+
+    const nanoseconds elapsed = clock_type::now() - start;
+    const auto made = allocations.load() - before;
+
+    return result{elapsed.count() / count, static_cast<double>(made) / count};
+}
+#endif
+} // namespace (anonymous)
+
+// Count every heap allocation of the program
+void * operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void * p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count;
+    size_t length;
+
+    po::options_description desc("Supported options");
+    desc.add_options()
+        ("help,h", "print help message")
+        ("count,c", po::value<size_t>(&count)->default_value(100000), "set number of messages")
+        ("length,l", po::value<size_t>(&length)->default_value(256), "set number of samples per message");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    std::vector<float> block(length, 0.5f);
+
+    // Warm the pool and the cache of this thread before measuring
+    signum::message_pool pool(16 + 9 * length);
+    pooled(pool, 100, block);
+
+    const auto plain = unpooled(count, block);
+    const auto reused = pooled(pool, count, block);
+
+    std::cout << std::setw(12) << "messages"
+              << std::setw(20) << "time (ns)"
+              << std::setw(20) << "allocations" << std::endl;
+
+    std::cout << std::setw(12) << "unpooled"
+              << std::setw(20) << plain.time
+              << std::setw(20) << plain.allocations << std::endl;
+    std::cout << std::setw(12) << "pooled"
+              << std::setw(20) << reused.time
+              << std::setw(20) << reused.allocations << std::endl;
+
+#ifdef SIGNUM_HAVE_ZEROMQ
+    // A message received into a message holds at most 1024 bytes
+    block.resize(std::min<size_t>(length, 200));
+
+    signum::zeromq::context ctx;
+    auto rep = ctx.make_socket(socket::types::reply);
+    auto req = ctx.make_socket(socket::types::request);
+    rep->bind("inproc://message_pool_benchmark");
+    req->connect("inproc://message_pool_benchmark");
+
+    pooled(pool, *req, *rep, 100, block);
+
+    const auto plain_socket = unpooled(*req, *rep, count, block);
+    const auto reused_socket = pooled(pool, *req, *rep, count, block);
+
+    std::cout << std::setw(12) << "unpooled rt"
+              << std::setw(20) << plain_socket.time
+              << std::setw(20) << plain_socket.allocations << std::endl;
+    std::cout << std::setw(12) << "pooled rt"
+              << std::setw(20) << reused_socket.time
+              << std::setw(20) << reused_socket.allocations << std::endl;
+#endif
+
+    return 0;
+}
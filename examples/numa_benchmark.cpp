@@ -0,0 +1,169 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <boost/program_options.hpp>
+
+#include <signum/circular_buffer.hpp>
+
+namespace po = boost::program_options;
+namespace cb = signum::circular_buffer;
+
+namespace
+{
+using clock_type = std::chrono::steady_clock;
+
+//! Returns the processors of a node, or none if the node does not exist
+std::vector<int> node_cpus(int node)
+{
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::vector<int> cpus;
+    std::string range;
+
+    // The list is a comma separated list of ranges such as 0-3,8-11
+    while (std::getline(file, range, ','))
+    {
+        std::istringstream ss(range);
+        int first, last;
+        char dash;
+        if (!(ss >> first))
+            continue;
+        last = (ss >> dash >> last) ? last : first;
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+//! Restrict the calling thread to the processors of a node
+void pin(const std::vector<int> & cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+        CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+//! Returns the throughput of a buffer on one node used by threads on another
+double throughput(size_t length, size_t block, size_t items, int buffer_node,
+                  const std::vector<int> & cpus)
+{
+    cb::options opts;
+    opts.node = buffer_node;
+
+    auto wr = cb::writer<float>(length, opts);
+    auto rd = wr.make_reader();
+
+    // Fault in every page before timing so they land on the buffer node
+    std::fill_n(wr.begin(), wr.size(), 0.0f);
+
+    const auto start = clock_type::now();
+
+    std::thread producer([&]{
+        pin(cpus);
+        for (size_t n = 0; n < items; n += block)
+        {
+            const auto count = std::min(block, items - n);
+            wr.wait(count);
+            std::fill_n(wr.begin(), count, static_cast<float>(n));
+            wr.consume(count);
+        }
+    });
+
+    std::thread consumer([&]{
+        pin(cpus);
+        float sum = 0;
+        for (size_t n = 0; n < items; n += block)
+        {
+            const auto count = std::min(block, items - n);
+            rd.wait(count);
+            sum = std::accumulate(rd.begin(), rd.begin() + count, sum);
+            rd.consume(count);
+        }
+        volatile float sink = sum;
+        (void) sink;
+    });
+
+    producer.join();
+    consumer.join();
+
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+
+    return items / elapsed.count();
+}
+} // namespace (anonymous)
+
+int main(int argc, char *argv[])
+{
+    size_t length;
+    size_t block;
+    size_t items;
+
+    po::options_description desc("Supported options");
+    desc.add_options()
+        ("help,h", "print help message")
+        ("length,l", po::value<size_t>(&length)->default_value(1 << 20), "set buffer length in items")
+        ("block,b", po::value<size_t>(&block)->default_value(4096), "set block size in items")
+        ("items,n", po::value<size_t>(&items)->default_value(500000000), "set number of items to transfer");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cerr << desc << std::endl;
+        return 1;
+    }
+
+    if (block == 0 || block > length)
+    {
+        std::cerr << "Block size must be nonzero and no larger than the buffer" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::vector<int>> nodes;
+    for (auto cpus = node_cpus(0); !cpus.empty(); cpus = node_cpus(nodes.size()))
+        nodes.push_back(cpus);
+
+    if (nodes.empty())
+    {
+        std::cerr << "No NUMA nodes found" << std::endl;
+        return 1;
+    }
+    if (nodes.size() == 1)
+        std::cerr << "Only one NUMA node, so every buffer is local" << std::endl;
+
+    std::cout << std::setw(8) << "buffer"
+              << std::setw(8) << "threads"
+              << std::setw(24) << "throughput (items/s)" << std::endl;
+
+    for (size_t buffer_node = 0; buffer_node < nodes.size(); ++buffer_node)
+    {
+        for (size_t thread_node = 0; thread_node < nodes.size(); ++thread_node)
+        {
+            std::cout << std::setw(8) << buffer_node
+                      << std::setw(8) << thread_node
+                      << std::setw(24) << throughput(length, block, items, buffer_node,
+                                                     nodes[thread_node])
+                      << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -34,6 +34,8 @@ public:
 
   buffer();
 
+  buffer(pointer data, size_type size);
+
   buffer(std::vector<T> &vec);
 
   template<std::size_t N>
@@ -71,6 +73,11 @@ buffer<T>::buffer()
     : d_begin(nullptr), d_end(nullptr)
 { }
 
+template<typename T>
+buffer<T>::buffer(pointer data, size_type size)
+    : d_begin(data), d_end(data + size)
+{ }
+
 template<typename T>
 buffer<T>::buffer(std::vector<T> &vec)
     : d_begin(vec.data()), d_end(vec.data() + vec.size())
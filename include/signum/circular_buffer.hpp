@@ -20,11 +20,16 @@
 #define SIGNUM_CIRCULAR_BUFFER_HPP_
 
 #include <atomic>  // for std::atomic
+#include <chrono>  // for std::chrono::steady_clock
 #include <cstddef> // for std::size_t
+#include <cstdint> // for std::uint32_t
+#include <deque>
 #include <limits>  // for std::numeric_limits
 #include <memory>  // for std::shared_ptr
 #include <mutex>
-#include <condition_variable>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace signum
 {
@@ -33,33 +38,451 @@ namespace circular_buffer
 
 template<typename> class writer;
 template<typename> class reader;
+template<typename> class work_queue;
+
+//! The sizes of pages that may back a buffer
+enum class page_sizes
+{
+    system,   //!< the system page size
+    huge_2mb, //!< 2 MiB huge pages
+    huge_1gb  //!< 1 GiB huge pages
+};
+
+//! The ways a reader or writer may wait on the opposite side
+enum class wait_modes
+{
+    block, //!< sleep in the kernel until woken
+    spin,  //!< poll a number of times and then sleep in the kernel
+    poll   //!< poll until satisfied without ever sleeping
+};
+
+/*!
+ * \brief A policy for waiting on the opposite side of a buffer
+ *
+ * Polling avoids the wake up latency of the kernel at the cost of a busy
+ * processor, which suits stages running on isolated cores.
+ */
+struct wait_policy
+{
+    wait_modes mode = wait_modes::block; //!< how to wait
+    unsigned spins = 1000; //!< polls before sleeping in spin mode
+};
+
+/*!
+ * \brief The ways a writer may handle a reader that has fallen behind
+ *
+ * With either drop mode the writer never blocks, so a stalled reader can not
+ * stall the thread producing items. Items a reader is still accessing may be
+ * overwritten when dropped, so such a reader should check its overruns.
+ */
+enum class overrun_modes
+{
+    block,       //!< wait for the slowest reader to consume items
+    drop_oldest, //!< advance slow readers past the oldest items
+    drop_newest  //!< discard items that do not fit
+};
+
+/*!
+ * \brief Options for constructing a buffer
+ *
+ * Huge pages reduce TLB misses for large buffers. The buffer size is rounded
+ * up to the huge page size, and system pages are used instead if no huge
+ * pages of the requested size are available.
+ *
+ * Locking faults in both halves of the mapping at construction and keeps
+ * them resident, so real-time threads never take a page fault on the buffer.
+ * Construction fails if the pages cannot be locked, which is limited by
+ * RLIMIT_MEMLOCK for unprivileged processes. Both halves of the mapping are
+ * charged against the limit, so twice the buffer size must fit.
+ *
+ * On NUMA systems the pages may be placed on a preferred node before any are
+ * faulted in, instead of on the node of whichever thread touches them first.
+ * Preferring node zero is a no-op on a single node system that does not
+ * support or permit binding, and other failures throw std::system_error.
+ */
+struct options
+{
+    page_sizes pages = page_sizes::system; //!< the size of backing pages
+    wait_policy wait; //!< the initial wait policy of the writer and readers
+    overrun_modes overrun = overrun_modes::block; //!< how the writer overruns
+    bool lock = false; //!< prefault the pages and lock them in memory
+    int node = -1;     //!< the preferred NUMA node, or -1 for the default
+};
+
+/*!
+ * \brief Metadata attached to an item in a buffer
+ *
+ * Tags carry sample accurate information such as timestamps or burst
+ * boundaries alongside the items. The offset is the absolute index of the
+ * item, as returned by index() plus its position from begin().
+ */
+struct tag
+{
+    uint64_t offset;
+    std::string key;
+    std::vector<uint8_t> value;
+};
+
+/*!
+ * \brief A snapshot of the counters of a reader or writer
+ *
+ * The high water mark and blocked time are only counted when the library and
+ * its users are built with SIGNUM_CIRCULAR_BUFFER_STATS defined, and are zero
+ * otherwise, so the fast path is unchanged when they are not wanted. The
+ * signum.pc of a library built with the option adds the define to Cflags.
+ */
+struct statistics
+{
+    size_t items;      //!< number of items produced or consumed
+    size_t high_water; //!< most items held by the buffer at once
+    size_t overruns;   //!< number of items dropped
+    std::chrono::nanoseconds blocked; //!< time spent waiting in wait()
+};
 
 namespace detail
 {
-//! A class for shared data
+//! The read index of a single reader, kept on its own cache line to avoid
+//! false sharing
+struct alignas(64) reader_index
+{
+    //! A positioning index holds a read index the writer respects, but is
+    //! not yet the start of the reader
+    enum states : unsigned { free, attaching, reserved, attached, positioning };
+
+    std::atomic<size_t> read;     //!< absolute number of bytes consumed
+    std::atomic<size_t> overruns; //!< number of bytes dropped by the writer
+    std::atomic<uint64_t> blocked; //!< nanoseconds spent waiting
+    std::atomic<size_t> start;    //!< read index when attached
+    std::atomic<unsigned> state;  //!< whether the writer must respect the index
+    std::atomic<uint32_t> item_size; //!< size of the items of the reader
+};
+
+static_assert(sizeof(reader_index) == 64 && alignof(reader_index) == 64,
+              "a reader index must fill one cache line");
+
+//! An eventfd signalled when enough items are available to a reader
+struct notifier
+{
+    enum states : unsigned { closed, idle, armed, signalling };
+
+    int fd = -1;
+    size_t threshold = 0; //!< in bytes
+    const reader_index * index = nullptr;
+    std::atomic<unsigned> state{closed};
+};
+
+//! A futex based event that threads on one side of a buffer may sleep on
+struct event
+{
+    std::atomic<uint32_t> sequence; //!< futex word incremented on each wake
+    std::atomic<uint32_t> waiters;  //!< number of threads sleeping
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "circular_buffer::event: atomic cannot be used as a futex");
+
+//! Sleep until the futex word differs from an expected value or a timeout
+void futex_wait(std::atomic<uint32_t> & word, uint32_t expected, bool shared,
+                std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max());
+
+//! Hint to the processor that the caller is polling
+inline void relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+//! Wake every thread sleeping on a futex word
+void futex_wake(std::atomic<uint32_t> & word, bool shared);
+
+//! Read from a descriptor, returning -1 if it would block
+std::ptrdiff_t read_some(int fd, void * data, size_t size);
+
+//! Write to a descriptor, returning -1 if it would block
+std::ptrdiff_t write_some(int fd, const void * data, size_t size);
+
+/*!
+ * \brief A class for shared data
+ *
+ * The write index and each read index are owned by a single thread and
+ * published with release stores, so the fast path of every side is lock
+ * free. Indices are absolute byte counts and are reduced modulo the buffer
+ * size only to locate items, so a reader may view the items of the writer
+ * as another type of a compatible size. A futex system call is only made when some
+ * thread on the opposite side has announced that it is sleeping by
+ * incrementing the waiter count of the corresponding event.
+ *
+ * A writer may feed several readers. Each reader has its own read index and
+ * the space available to the writer is limited by the slowest one.
+ *
+ * The indices and events live in a control block. An anonymous buffer keeps
+ * it on the heap. A named buffer keeps it at the start of a POSIX shared
+ * memory object followed by the items, so a writer in one process and
+ * readers in others share the buffer without copies.
+ */
 class impl
 {
 public:
-    explicit impl(size_t num_items, size_t item_size);
+    //! The maximum number of readers attached to a buffer at once
+    static constexpr size_t max_readers = 16;
+
+    //! Construct an anonymous buffer
+    explicit impl(size_t num_items, size_t item_size,
+                  const options & opts = options());
+
+    //! Create a named buffer shared between processes
+    impl(const std::string & name, size_t num_items, size_t item_size,
+         const options & opts = options());
+
+    //! Open a named buffer created by another process
+    impl(const std::string & name, size_t item_size);
+
     ~impl();
     impl(const impl &) = delete;
     impl(impl &&) = delete;
     impl & operator=(const impl &) = delete;
     impl & operator=(impl &&) = delete;
+
+    //! Attach a new reader of items of a size and alignment at the write index
+    reader_index * attach(size_t item_size, size_t alignment);
+
+    //! Detach a reader so it no longer limits the writer
+    void detach(reader_index * index);
+
+    //! Returns an eventfd for a reader signalled at a threshold of bytes
+    notifier * open_notifier(const reader_index * index, size_t threshold);
+
+    //! Close the eventfd of a reader
+    void close_notifier(notifier * ntf);
+
+    //! Arm the eventfd of a reader, or signal it if enough items are available
+    void arm(notifier * ntf);
+
+    //! Signal the eventfds of readers with enough items available
+    void signal();
+
+    //! Returns the read index of the slowest attached reader
+    size_t tail() const;
+
+    //! Attach a tag to an item and discard tags every reader has passed
+    void add_tag(tag t);
+
+    //! Returns the tags of items in the range [first, last) and discards
+    //! those every reader has passed
+    std::vector<tag> tags(size_t first, size_t last);
+
+    //! Advance slow readers so the writer has space for a number of bytes
+    void drop(size_t n);
+
+    //! Returns the size of the pages backing the buffer
+    size_t page_size() const { return d_page_size; }
+
+    //! Prefer a NUMA node for the pages, optionally moving those in memory
+    void bind(int node, bool move);
+
+    //! Returns the NUMA node of the calling thread
+    static int current_node();
+
+    //! Returns whether the writer uses this object, and so sees the state
+    //! kept in the process, unlike a buffer opened by name
+    bool has_writer() const { return d_name.empty() || d_owner; }
+
+    //! Returns the initial wait policy of the writer and readers
+    const wait_policy & get_wait_policy() const { return d_wait_policy; }
+
+    //! Returns how the writer handles readers that have fallen behind
+    overrun_modes overrun() const
+    {
+        return static_cast<overrun_modes>(d_control->overrun);
+    }
+
 private:
     template<typename> friend class ::signum::circular_buffer::writer;
     template<typename> friend class ::signum::circular_buffer::reader;
+    template<typename> friend class ::signum::circular_buffer::work_queue;
     template<template<typename> class, typename> friend class base;
+
+    struct control
+    {
+        std::atomic<uint32_t> magic; //!< set last once the block is ready
+        uint32_t item_size;              //!< size of the items of the writer
+        uint64_t size;
+        uint32_t overrun;                //!< the overrun_modes of the writer
+        std::atomic<size_t> overruns;    //!< number of bytes dropped in total
+        std::atomic<size_t> num_readers; //!< high water mark of used indices
+        event read_event;  //!< signalled when a read index advances
+        // Keep the write index on its own cache line to avoid false sharing
+        alignas(64) std::atomic<size_t> write;
+        event write_event; //!< signalled when the write index advances
+        std::atomic<size_t> high_water;     //!< most bytes held at once
+        std::atomic<uint64_t> write_blocked; //!< nanoseconds the writer waited
+        reader_index readers[max_readers];
+    };
+
+    static_assert(alignof(control) == 64, "the control block must be cache aligned");
+
+    //! Allocate an anonymous control block, which operator new does not align
+    static control * allocate_control();
+
+    //! Free an anonymous control block
+    static void deallocate_control(control * ctrl);
+
+    void initialize(size_t item_size, overrun_modes overrun);
+
+    //! Discard the tags every reader has passed, with the tag mutex held
+    void prune_tags();
+
+    //! Wait on an event until a predicate is satisfied or a deadline passes
+    template<typename Predicate>
+    bool wait(event & ev, const wait_policy & policy, Predicate pred,
+              std::chrono::steady_clock::time_point deadline) const;
+
+    //! Wake the threads sleeping on an event, if there are any
+    void wake(event & ev) const;
+
+    //! Publish an index and wake the opposite side only if it is blocked
+    void notify(std::atomic<size_t> & index, size_t pos, event & ev) const;
+
     void * d_base;
     size_t d_size;
-    std::atomic<size_t> d_read;
-    std::mutex d_read_mutex;
-    std::condition_variable d_read_cond;
-    std::atomic<size_t> d_write;
-    std::mutex d_write_mutex;
-    std::condition_variable d_write_cond;
+    size_t d_page_size;
+    control * d_control;
+    std::string d_name;   //!< name of the shared memory object, if any
+    size_t d_header_size; //!< size of the mapped control block, if named
+    bool d_owner;         //!< whether to unlink the shared memory object
+    wait_policy d_wait_policy;
+    // Notifiers are local to the process of the writer
+    std::atomic<unsigned> d_armed{0}; //!< number of armed notifiers
+    notifier d_notifiers[max_readers];
+    // Tags are local to the process of the writer
+    std::atomic<size_t> d_num_tags{0}; //!< allows readers to skip the lock
+    std::mutex d_tag_mutex;
+    std::deque<tag> d_tags; //!< ordered by offset
 };
 
+inline size_t impl::tail() const
+{
+    const auto & ctrl = *d_control;
+    auto write = ctrl.write.load(std::memory_order_relaxed);
+    auto result = write;
+
+    const auto num = ctrl.num_readers.load(std::memory_order_acquire);
+    for (size_t i = 0; i < num; ++i)
+    {
+        const auto & index = ctrl.readers[i];
+        const auto state = index.state.load(std::memory_order_acquire);
+        if (state == reader_index::free || state == reader_index::attaching)
+            continue;
+        // A reader may already be past the write index loaded above, which
+        // would otherwise wrap around and look like the slowest reader
+        auto read = index.read.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(read - write) > 0)
+            read = write;
+        if (write - read > write - result)
+            result = read;
+    }
+
+    return result;
+}
+
+template<typename Predicate>
+bool impl::wait(event & ev, const wait_policy & policy, Predicate pred,
+                std::chrono::steady_clock::time_point deadline) const
+{
+    using clock = std::chrono::steady_clock;
+
+    if (pred())
+        return true;
+
+    const bool forever = deadline == clock::time_point::max();
+
+    // Poll before sleeping, or instead of sleeping
+    if (policy.mode != wait_modes::block)
+    {
+        const bool poll = policy.mode == wait_modes::poll;
+        for (unsigned i = 0; poll || i < policy.spins; ++i)
+        {
+            relax();
+            if (pred())
+                return true;
+            if (!forever && clock::now() >= deadline)
+                return false;
+        }
+    }
+
+    bool satisfied = true;
+
+    ev.waiters.fetch_add(1, std::memory_order_relaxed);
+    // Order the count before the index loads in the predicate (see wake)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (;;)
+    {
+        const auto sequence = ev.sequence.load(std::memory_order_acquire);
+        if (pred())
+            break;
+        if (forever)
+        {
+            futex_wait(ev.sequence, sequence, !d_name.empty());
+        }
+        else
+        {
+            const auto remaining = deadline - clock::now();
+            if (remaining <= clock::duration::zero())
+            {
+                satisfied = false;
+                break;
+            }
+            futex_wait(ev.sequence, sequence, !d_name.empty(), remaining);
+        }
+    }
+    ev.waiters.fetch_sub(1, std::memory_order_relaxed);
+
+    return satisfied;
+}
+
+inline void impl::wake(event & ev) const
+{
+    // Order a preceding index store before the count load (see wait)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ev.waiters.load(std::memory_order_relaxed) != 0)
+    {
+        ev.sequence.fetch_add(1, std::memory_order_release);
+        futex_wake(ev.sequence, !d_name.empty());
+    }
+}
+
+inline void impl::notify(std::atomic<size_t> & index, size_t pos, event & ev) const
+{
+    index.store(pos, std::memory_order_release);
+    wake(ev);
+}
+
+/*!
+ * \brief Returns the deadline of a timeout on the steady clock
+ *
+ * A timeout past the end of the clock, such as duration::max(), would
+ * overflow the deadline, so it has none and time_point::max() is returned.
+ * The comparison is in floating point so that a coarse duration is not
+ * converted either. A negative timeout expires now.
+ */
+template<typename Rep, typename Period>
+std::chrono::steady_clock::time_point
+deadline_after(const std::chrono::duration<Rep,Period> & timeout)
+{
+    using std::chrono::steady_clock;
+
+    const auto now = steady_clock::now();
+    if (timeout <= timeout.zero())
+        return now;
+
+    using seconds = std::chrono::duration<double>;
+    if (seconds(timeout) >= seconds(steady_clock::time_point::max() - now))
+        return steady_clock::time_point::max();
+
+    return now + std::chrono::duration_cast<steady_clock::duration>(timeout);
+}
+
 //! A base class for a buffer
 template<template<typename> class T, typename U>
 class base
@@ -78,6 +501,9 @@ public:
     static_assert(std::numeric_limits<size_type>::is_modulo,
                   "circular_buffer::base: modulo arithmetic not supported");
 
+    static_assert(std::numeric_limits<size_type>::digits >= 64,
+                  "circular_buffer::base: absolute indices may overflow");
+
     //! Returns an iterator to the beginning of the buffer
     iterator begin();
 
@@ -97,7 +523,7 @@ public:
     const_iterator cend() const { return end(); }
 
     //! Checks whether the buffer is empty
-    bool empty() const { return d_impl->d_write == d_impl->d_read; }
+    bool empty() const { return size() == 0; }
 
     //! Returns the number of items in the buffer
     size_type size() const;
@@ -105,10 +531,55 @@ public:
     //! Returns the maximum size of the buffer
     size_type max_size() const;
 
+    //! Returns the absolute index of the item at the beginning of the buffer
+    size_type index() const
+    {
+        return static_cast<const T<U> *>(this)->position() / sizeof(U);
+    }
+
     //! Consume items from the buffer
     void consume(size_type n);
 
+    //! Wait for the size of the buffer to reach a number of items
+    void wait(size_type n);
+
+    /*!
+     * \brief Wait for the size of the buffer to reach a number of items
+     * \param n the number of items
+     * \param timeout the longest time to wait
+     * \returns the size of the buffer, which is less than n on a timeout
+     */
+    template<typename Rep, typename Period>
+    size_type wait_for(size_type n,
+                       const std::chrono::duration<Rep,Period> & timeout);
+
+    /*!
+     * \brief Wait for the size of the buffer to reach a number of items
+     * \param n the number of items
+     * \param deadline the latest time to wait until
+     * \returns the size of the buffer, which is less than n on a timeout
+     */
+    template<typename Clock, typename Duration>
+    size_type wait_until(size_type n,
+                         const std::chrono::time_point<Clock,Duration> & deadline);
+
+    //! Returns the policy used when waiting
+    const wait_policy & get_wait_policy() const { return d_wait_policy; }
+
+    //! Set the policy used when waiting
+    void set_wait_policy(const wait_policy & policy) { d_wait_policy = policy; }
+
 protected:
+    //! Returns the number of items the mapping holds
+    size_type capacity() const { return d_impl->d_size / sizeof(U); }
+
+    //! Returns the item at an absolute byte index
+    pointer at(size_type pos) const
+    {
+        const auto base = static_cast<char *>(d_impl->d_base);
+        return reinterpret_cast<pointer>(base + pos % d_impl->d_size);
+    }
+
     explicit base(size_type n);
 
     explicit base(std::shared_ptr<impl> ptr);
@@ -123,7 +594,12 @@ protected:
 
     std::shared_ptr<impl> d_impl;
 
+    wait_policy d_wait_policy;
+
 private:
+    //! Wait for a number of items, counting the time spent if instrumented
+    void block(size_type n, std::chrono::steady_clock::time_point deadline);
+
     template<template<typename> class V, typename X,
              template<typename> class Y, typename Z>
     friend bool operator==(const base<V,X> & lhs, const base<Y,Z> & rhs);
@@ -131,26 +607,26 @@ private:
 
 template<template<typename> class T, typename U>
 base<T,U>::base(size_type n)
-    : d_impl{std::make_shared<impl>(n, sizeof(U))}
+    : d_impl{std::make_shared<impl>(n, sizeof(U))},
+      d_wait_policy{d_impl->get_wait_policy()}
 { }
 
 template<template<typename> class T, typename U>
 base<T,U>::base(std::shared_ptr<impl> ptr)
-    : d_impl{ptr}
+    : d_impl{ptr},
+      d_wait_policy{ptr->get_wait_policy()}
 { }
 
 template<template<typename> class T, typename U>
 typename base<T,U>::iterator base<T,U>::begin()
 {
-    const auto base = static_cast<pointer>(d_impl->d_base);
-    return base + static_cast<const T<U> *>(this)->position();
+    return at(static_cast<const T<U> *>(this)->position());
 }
 
 template<template<typename> class T, typename U>
 typename base<T,U>::const_iterator base<T,U>::begin() const
 {
-    const auto base = static_cast<pointer>(d_impl->d_base);
-    return base + static_cast<const T<U> *>(this)->position();
+    return at(static_cast<const T<U> *>(this)->position());
 }
 
 template<template<typename> class T, typename U>
@@ -168,34 +644,100 @@ typename base<T,U>::const_iterator base<T,U>::end() const
 template<template<typename> class T, typename U>
 typename base<T,U>::size_type base<T,U>::size() const
 {
-    const auto max = std::numeric_limits<size_type>::max();
-    const auto underflow = max - d_impl->d_size / sizeof(U) + 1;
+    return static_cast<const T<U> *>(this)->offset();
+}
 
-    auto sz = static_cast<const T<U> *>(this)->offset();
+template<template<typename> class T, typename U>
+typename base<T,U>::size_type base<T,U>::max_size() const
+{
+    return capacity() - 1;
+}
 
-    if (sz >= underflow)
-        sz -= underflow;
+template<template<typename> class T, typename U>
+void base<T,U>::consume(size_type n)
+{
+    const auto pos = static_cast<const T<U> *>(this)->position() + n * sizeof(U);
 
-    return sz;
+    static_cast<T<U>*>(this)->update(pos);
 }
 
 template<template<typename> class T, typename U>
-typename base<T,U>::size_type base<T,U>::max_size() const
+void base<T,U>::wait(size_type n)
 {
-    return d_impl->d_size / sizeof(U) - 1;
+    if (static_cast<T<U>*>(this)->overrun(n))
+        return;
+
+    block(n, std::chrono::steady_clock::time_point::max());
 }
 
 template<template<typename> class T, typename U>
-void base<T,U>::consume(size_type n)
+template<typename Rep, typename Period>
+typename base<T,U>::size_type
+base<T,U>::wait_for(size_type n, const std::chrono::duration<Rep,Period> & timeout)
 {
-    const auto overflow = d_impl->d_size / sizeof(U);
+    return wait_until(n, deadline_after(timeout));
+}
 
-    auto pos = static_cast<const T<U> *>(this)->position() + n;
+template<template<typename> class T, typename U>
+template<typename Clock, typename Duration>
+typename base<T,U>::size_type
+base<T,U>::wait_until(size_type n,
+                      const std::chrono::time_point<Clock,Duration> & deadline)
+{
+    using std::chrono::steady_clock;
 
-    if (pos >= overflow)
-        pos -= overflow;
+    if (static_cast<T<U>*>(this)->overrun(n))
+        return size();
 
-    static_cast<T<U>*>(this)->update(pos);
+    if (deadline == std::chrono::time_point<Clock,Duration>::max())
+    {
+        wait(n);
+        return size();
+    }
+
+    // Express the deadline in terms of the clock used by the futex, where a
+    // deadline past the end of that clock waits without one
+    const auto clock_now = Clock::now();
+    const auto now = steady_clock::now();
+    if (deadline <= clock_now)
+    {
+        block(n, now);
+        return size();
+    }
+
+    const auto remaining = deadline - clock_now;
+    using seconds = std::chrono::duration<double>;
+    if (seconds(remaining) >= seconds(steady_clock::time_point::max() - now))
+    {
+        block(n, steady_clock::time_point::max());
+        return size();
+    }
+
+    block(n, now + std::chrono::duration_cast<steady_clock::duration>(remaining));
+
+    return size();
+}
+
+template<template<typename> class T, typename U>
+void base<T,U>::block(size_type n, std::chrono::steady_clock::time_point deadline)
+{
+    auto & derived = *static_cast<T<U>*>(this);
+    auto pred = [&]{ return this->size() >= n; };
+
+#ifdef SIGNUM_CIRCULAR_BUFFER_STATS
+    using std::chrono::steady_clock;
+
+    if (pred())
+        return;
+
+    const auto start = steady_clock::now();
+    d_impl->wait(derived.wait_event(), d_wait_policy, pred, deadline);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        steady_clock::now() - start);
+    derived.blocked().fetch_add(elapsed.count(), std::memory_order_relaxed);
+#else
+    d_impl->wait(derived.wait_event(), d_wait_policy, pred, deadline);
+#endif
 }
 
 //! Returns true of two buffers share the same data
@@ -233,20 +775,94 @@ public:
     using iterator        = T *;
     using const_iterator  = const T *;
 
+    //! Open a named buffer created by a writer in another process
+    explicit reader(const std::string & name);
+
     reader(const reader &) = delete;
 
-    reader(reader &&) = default;
+    reader(reader &&other);
 
-    reader & operator=(const reader &) = delete;
+    ~reader();
 
-    reader & operator=(reader &&) = default;
+    reader & operator=(const reader &) = delete;
 
-    //! Wait for a number of items to be in the buffer
-    void wait(size_type n);
+    reader & operator=(reader &&other);
 
     //! Consume all items in the buffer
     void clear() { this->consume(this->size()); }
 
+    //! Returns the number of items the writer dropped before they were read
+    size_type overruns() const
+    {
+        return d_index->overruns.load(std::memory_order_relaxed) / sizeof(T);
+    }
+
+    /*!
+     * \brief Returns a file descriptor that is readable while items are available
+     *
+     * The descriptor is an eventfd owned by the reader. It becomes readable
+     * once at least a threshold of items is in the buffer and stays readable
+     * until the reader consumes enough items to fall below it, so buffers may
+     * be waited on by poll or epoll together with sockets. Calling this again
+     * changes the threshold.
+     *
+     * \throws std::logic_error for a reader of a buffer opened by name, as
+     *         only the writer that made the reader signals the descriptor
+     */
+    int event_fd(size_type threshold = 1);
+
+    /*!
+     * \brief Write items from the buffer to a file descriptor
+     *
+     * Items are written with a single system call straight from the buffer
+     * and whole items that were written are consumed. The bytes of a
+     * partially written item are remembered and it is consumed once the rest
+     * is written. If the reader is moved in the meantime, by consume() or a
+     * writer dropping the oldest items, the rest of that item is abandoned.
+     *
+     * \returns the number of bytes written, or -1 if the buffer is empty or
+     *          the descriptor would block
+     * \throws std::system_error on any other error
+     */
+    difference_type drain_to(int fd);
+
+    //! Returns a snapshot of the counters of the reader
+    statistics stats() const
+    {
+        const auto & ctrl = *base_type::d_impl->d_control;
+        // Items the writer dropped moved the read index but were never read.
+        // The read index is advanced before the overruns are counted.
+        const size_type read = d_index->read.load(std::memory_order_relaxed) -
+                               d_index->start.load(std::memory_order_relaxed);
+        const size_type overruns = d_index->overruns.load(std::memory_order_relaxed);
+        return {
+            (read > overruns ? read - overruns : 0) / sizeof(T),
+            ctrl.high_water.load(std::memory_order_relaxed) / sizeof(T),
+            overruns / sizeof(T),
+            std::chrono::nanoseconds(d_index->blocked.load(std::memory_order_relaxed))
+        };
+    }
+
+    /*!
+     * \brief Prefer the NUMA node of the calling thread for the buffer
+     *
+     * Pages faulted in afterwards are placed on the node, and pages already
+     * in memory are moved if this process is the only one mapping them. It
+     * is meant to be called by the consuming thread before items flow.
+     */
+    void bind_local()
+    {
+        auto & impl = *base_type::d_impl;
+        impl.bind(impl.current_node(), true);
+    }
+
+    /*!
+     * \brief Returns the tags of the items in the buffer ordered by offset
+     * \throws std::logic_error for a reader of a buffer opened by name, as
+     *         tags are kept by the writer that made the reader
+     */
+    std::vector<tag> tags() const;
+
 private:
     using base_type = detail::base<reader,value_type>;
 
@@ -258,34 +874,184 @@ private:
 
     size_type offset() const
     {
-        return base_type::d_impl->d_write - base_type::d_impl->d_read;
+        // A dropping writer may advance the read index, so load it first
+        const auto & ctrl = *base_type::d_impl->d_control;
+        const auto read = d_index->read.load(std::memory_order_acquire);
+        return (ctrl.write.load(std::memory_order_acquire) - read) / sizeof(T);
     }
 
     size_type position() const
     {
-        return base_type::d_impl->d_read;
+        return d_index->read.load(std::memory_order_relaxed);
+    }
+
+    //! Readers wait for the write index to advance
+    detail::event & wait_event()
+    {
+        return base_type::d_impl->d_control->write_event;
     }
 
+    std::atomic<uint64_t> & blocked() { return d_index->blocked; }
+
+    //! Readers never overrun
+    bool overrun(size_type) const { return false; }
+
     void update(size_type pos)
     {
+        auto & impl = *base_type::d_impl;
+
+        if (d_drop)
+        {
+            // Never move backwards past items the writer has dropped
+            auto read = d_index->read.load(std::memory_order_relaxed);
+            while (static_cast<difference_type>(pos - read) > 0 &&
+                   !d_index->read.compare_exchange_weak(read, pos,
+                        std::memory_order_release, std::memory_order_relaxed))
+                ;
+            impl.wake(impl.d_control->read_event);
+        }
+        else
         {
-            std::lock_guard<std::mutex> lock(base_type::d_impl->d_read_mutex);
-            base_type::d_impl->d_read = pos;
+            impl.notify(d_index->read, pos, impl.d_control->read_event);
         }
-        base_type::d_impl->d_read_cond.notify_all();
+
+        if (d_notifier && this->size() * sizeof(T) < d_notifier->threshold)
+            impl.arm(d_notifier);
     }
+
+    detail::reader_index * d_index;
+    bool d_drop; //!< whether the writer may advance the read index
+    detail::notifier * d_notifier;
+    size_type d_partial; //!< bytes of the first item already drained
+    size_type d_partial_pos; //!< the read index the partial bytes belong to
 };
 
 template<typename T>
 reader<T>::reader(std::shared_ptr<detail::impl> ptr)
-    : detail::base<reader,T>(ptr)
+    : detail::base<reader,T>(ptr),
+      d_index(ptr->attach(sizeof(T), alignof(T))),
+      d_drop(ptr->overrun() == overrun_modes::drop_oldest),
+      d_notifier(nullptr),
+      d_partial(0),
+      d_partial_pos(0)
 { }
 
 template<typename T>
-void reader<T>::wait(size_type n)
+int reader<T>::event_fd(size_type threshold)
+{
+    auto & impl = *base_type::d_impl;
+
+    if (!impl.has_writer())
+        throw std::logic_error(std::string(__func__) +
+                               ": the writer is in another process");
+
+    if (d_notifier)
+    {
+        impl.close_notifier(d_notifier);
+        d_notifier = nullptr;
+    }
+
+    if (threshold == 0 || threshold > this->max_size())
+        throw std::invalid_argument(std::string(__func__) + ": invalid threshold");
+
+    d_notifier = impl.open_notifier(d_index, threshold * sizeof(T));
+    impl.arm(d_notifier);
+
+    return d_notifier->fd;
+}
+
+template<typename T>
+std::vector<tag> reader<T>::tags() const
 {
-    std::unique_lock<std::mutex> lock(base_type::d_impl->d_write_mutex);
-    base_type::d_impl->d_write_cond.wait(lock, [&]{ return this->size() >= n; });
+    auto & impl = *base_type::d_impl;
+    if (!impl.has_writer())
+        throw std::logic_error(std::string(__func__) +
+                               ": the writer is in another process");
+
+    if (impl.d_num_tags.load(std::memory_order_acquire) == 0)
+        return {};
+
+    // Tags are kept by byte index and returned by the index of this reader
+    const auto pos = position();
+    auto result = impl.tags(pos, pos + this->size() * sizeof(T));
+    for (auto & t : result)
+        t.offset = this->index() + (t.offset - pos) / sizeof(T);
+
+    return result;
+}
+
+template<typename T>
+typename reader<T>::difference_type reader<T>::drain_to(int fd)
+{
+    // The partial bytes only belong to the first item if it has not moved
+    if (d_partial != 0 && position() != d_partial_pos)
+        d_partial = 0;
+
+    const size_type bytes = this->size() * sizeof(T);
+    if (bytes == 0)
+        return -1;
+
+    const auto data = reinterpret_cast<const char *>(this->begin()) + d_partial;
+    const auto n = detail::write_some(fd, data, bytes - d_partial);
+    if (n > 0)
+    {
+        d_partial += n;
+        const auto items = d_partial / sizeof(T);
+        d_partial %= sizeof(T);
+        if (items != 0)
+            this->consume(items);
+        d_partial_pos = position();
+    }
+
+    return n;
+}
+
+template<typename T>
+reader<T>::reader(const std::string & name)
+    : reader(std::make_shared<detail::impl>(name, sizeof(T)))
+{ }
+
+template<typename T>
+reader<T>::reader(reader &&other)
+    : detail::base<reader,T>(std::move(other)),
+      d_index(other.d_index),
+      d_drop(other.d_drop),
+      d_notifier(other.d_notifier),
+      d_partial(other.d_partial),
+      d_partial_pos(other.d_partial_pos)
+{
+    other.d_index = nullptr;
+    other.d_notifier = nullptr;
+}
+
+template<typename T>
+reader<T>::~reader()
+{
+    if (d_notifier)
+        base_type::d_impl->close_notifier(d_notifier);
+    if (d_index)
+        base_type::d_impl->detach(d_index);
+}
+
+template<typename T>
+reader<T> & reader<T>::operator=(reader &&other)
+{
+    if (this != &other)
+    {
+        if (d_notifier)
+            base_type::d_impl->close_notifier(d_notifier);
+        if (d_index)
+            base_type::d_impl->detach(d_index);
+        base_type::operator=(std::move(other));
+        d_index = other.d_index;
+        d_drop = other.d_drop;
+        d_notifier = other.d_notifier;
+        d_partial = other.d_partial;
+        d_partial_pos = other.d_partial_pos;
+        other.d_index = nullptr;
+        other.d_notifier = nullptr;
+    }
+    return *this;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -309,6 +1075,18 @@ public:
 
     explicit writer(size_type n);
 
+    writer(size_type n, const options & opts);
+
+    /*!
+     * \brief Create a named buffer that readers in other processes may open
+     *
+     * The name follows the rules of shm_open and must not already exist. It
+     * is unlinked when the writer is destroyed, after which no new readers
+     * may open it. Named buffers are always backed by system pages.
+     */
+    writer(const std::string & name, size_type n,
+           const options & opts = options());
+
     writer(const writer &) = delete;
 
     writer(writer &&) = default;
@@ -317,11 +1095,86 @@ public:
 
     writer & operator=(writer &&) = default;
 
-    //! Wait for a number of items to be in the buffer
-    void wait(size_type n);
-
+    /*!
+     * \brief Make a reader of the buffer
+     *
+     * Any number of readers up to detail::impl::max_readers may be made. Each
+     * reader receives every item written after it is made, and the first
+     * reader also receives items written before it. The writer is limited by
+     * the slowest reader and is not limited at all if every reader has been
+     * destroyed.
+     *
+     * A reader may view the items as another type, such as bytes from a
+     * device as complex samples, without copying. One of the item sizes
+     * must divide the other, and the reader must be made where the write
+     * index is aligned for its type. A partially written item of the reader
+     * is not available until it is complete.
+     *
+     * \throws std::invalid_argument if the reader would be misaligned
+     */
     template<typename U = T>
-    reader<value_type> make_reader();
+    reader<U> make_reader();
+
+    /*!
+     * \brief Produce items into the buffer
+     *
+     * When dropping the newest items, any items beyond the size of the buffer
+     * are counted as overruns instead, and must not have been written.
+     */
+    void consume(size_type n);
+
+    /*!
+     * \brief Returns the number of items dropped by the writer
+     *
+     * When dropping the oldest items, an item is counted once for each reader
+     * it was dropped from.
+     */
+    size_type overruns() const
+    {
+        const auto & ctrl = *base_type::d_impl->d_control;
+        return ctrl.overruns.load(std::memory_order_relaxed) / sizeof(T);
+    }
+
+    //! Returns a snapshot of the counters of the writer
+    statistics stats() const
+    {
+        const auto & ctrl = *base_type::d_impl->d_control;
+        return {
+            ctrl.write.load(std::memory_order_relaxed) / sizeof(T),
+            ctrl.high_water.load(std::memory_order_relaxed) / sizeof(T),
+            ctrl.overruns.load(std::memory_order_relaxed) / sizeof(T),
+            std::chrono::nanoseconds(ctrl.write_blocked.load(std::memory_order_relaxed))
+        };
+    }
+
+    /*!
+     * \brief Attach a tag to an item that has yet to be produced
+     *
+     * The item is given by its position from begin() and is tagged once it
+     * is produced. Tags are only seen by readers in the same process.
+     */
+    void add_tag(size_type offset, std::string key,
+                 std::vector<uint8_t> value = std::vector<uint8_t>());
+
+    /*!
+     * \brief Read items into the buffer from a file descriptor
+     *
+     * Items are read with a single system call straight into the buffer and
+     * whole items that were read are produced. The bytes of a partially read
+     * item are remembered and it is produced once the rest is read, so at the
+     * end of the file partial() bytes of an incomplete item remain unproduced.
+     *
+     * When dropping the oldest items a full buffer drops enough of them to
+     * make space for half the buffer, as waiting for space would.
+     *
+     * \returns the number of bytes read, zero at the end of the file, or -1
+     *          if the buffer is full or the descriptor would block
+     * \throws std::system_error on any other error
+     */
+    difference_type fill_from(int fd);
+
+    //! Returns the bytes of an incomplete item read by fill_from()
+    size_type partial() const { return d_partial; }
 
 private:
     using base_type = detail::base<writer,value_type>;
@@ -330,24 +1183,104 @@ private:
 
     size_type offset() const
     {
-        return base_type::d_impl->d_read - base_type::d_impl->d_write - 1;
+        const auto & impl = *base_type::d_impl;
+        const size_type used = impl.d_control->write.load(std::memory_order_relaxed) -
+                               impl.tail();
+        const size_type max_bytes = this->max_size() * sizeof(T);
+
+        // A reader being attached may briefly hold an index further behind
+        return used < max_bytes ? (max_bytes - used) / sizeof(T) : 0;
     }
 
     size_type position() const
     {
-        return base_type::d_impl->d_write;
+        return base_type::d_impl->d_control->write.load(std::memory_order_relaxed);
     }
 
-    void update(size_type pos) const
+    //! Writers wait for the read indices to advance
+    detail::event & wait_event()
+    {
+        return base_type::d_impl->d_control->read_event;
+    }
+
+    std::atomic<uint64_t> & blocked()
     {
+        return base_type::d_impl->d_control->write_blocked;
+    }
+
+    //! Make space for items instead of waiting when dropping items
+    bool overrun(size_type n)
+    {
+        switch (base_type::d_impl->overrun())
         {
-            std::lock_guard<std::mutex> lock(base_type::d_impl->d_write_mutex);
-            base_type::d_impl->d_write = pos;;
+        case overrun_modes::drop_oldest:
+            if (this->size() < n)
+                base_type::d_impl->drop(n * sizeof(T));
+            return true;
+        case overrun_modes::drop_newest:
+            return true;
+        default:
+            return false;
         }
-        base_type::d_impl->d_write_cond.notify_all();
     }
+
+    void update(size_type pos) const
+    {
+        auto & impl = *base_type::d_impl;
+        impl.notify(impl.d_control->write, pos, impl.d_control->write_event);
+        // The notify above orders the write index before this load (see arm)
+        if (impl.d_armed.load(std::memory_order_relaxed) != 0)
+            impl.signal();
+#ifdef SIGNUM_CIRCULAR_BUFFER_STATS
+        auto & high_water = impl.d_control->high_water;
+        const size_type held = pos - impl.tail();
+        auto max = high_water.load(std::memory_order_relaxed);
+        while (max < held && !high_water.compare_exchange_weak(max, held,
+                                                               std::memory_order_relaxed))
+            ;
+#endif
+    }
+
+    size_type d_partial = 0; //!< bytes of the first item already filled
 };
 
+template<typename T>
+void writer<T>::add_tag(size_type offset, std::string key,
+                        std::vector<uint8_t> value)
+{
+    if (offset >= this->size())
+        throw std::out_of_range(std::string(__func__) +
+                                ": offset exceeds the buffer size");
+
+    base_type::d_impl->add_tag({position() + offset * sizeof(T), std::move(key),
+                                std::move(value)});
+}
+
+template<typename T>
+typename writer<T>::difference_type writer<T>::fill_from(int fd)
+{
+    if (this->size() == 0 &&
+        base_type::d_impl->overrun() == overrun_modes::drop_oldest)
+        overrun(std::max<size_type>(this->max_size() / 2, 1));
+
+    const size_type bytes = this->size() * sizeof(T);
+    if (bytes == 0)
+        return -1;
+
+    const auto data = reinterpret_cast<char *>(this->begin()) + d_partial;
+    const auto n = detail::read_some(fd, data, bytes - d_partial);
+    if (n > 0)
+    {
+        d_partial += n;
+        const auto items = d_partial / sizeof(T);
+        d_partial %= sizeof(T);
+        if (items != 0)
+            consume(items);
+    }
+
+    return n;
+}
+
 template<typename T>
 writer<T>::writer()
     : detail::base<writer,T>{std::make_shared<detail::impl>(0, sizeof(T))}
@@ -359,17 +1292,42 @@ writer<T>::writer(size_type n)
 { }
 
 template<typename T>
-void writer<T>::wait(size_type n)
+writer<T>::writer(size_type n, const options & opts)
+    : detail::base<writer,T>{std::make_shared<detail::impl>(n, sizeof(T), opts)}
+{ }
+
+template<typename T>
+writer<T>::writer(const std::string & name, size_type n, const options & opts)
+    : detail::base<writer,T>{std::make_shared<detail::impl>(name, n, sizeof(T), opts)}
+{ }
+
+template<typename T>
+void writer<T>::consume(size_type n)
 {
-    std::unique_lock<std::mutex> lock(base_type::d_impl->d_read_mutex);
-    base_type::d_impl->d_read_cond.wait(lock, [&]{ return this->size() >= n; });
+    auto & impl = *base_type::d_impl;
+
+    if (impl.overrun() == overrun_modes::drop_newest)
+    {
+        const auto sz = this->size();
+        if (n > sz)
+        {
+            impl.d_control->overruns.fetch_add((n - sz) * sizeof(T),
+                                               std::memory_order_relaxed);
+            n = sz;
+        }
+    }
+
+    base_type::consume(n);
 }
 
 template<typename T>
 template<typename U>
-reader<T> writer<T>::make_reader()
+reader<U> writer<T>::make_reader()
 {
-    return std::move(reader<U>{detail::base<writer,T>::d_impl});
+    static_assert(sizeof(U) % sizeof(T) == 0 || sizeof(T) % sizeof(U) == 0,
+                  "circular_buffer::writer: item sizes are not compatible");
+
+    return reader<U>{detail::base<writer,T>::d_impl};
 }
 
 } // namespace circular_buffer
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#ifndef SIGNUM_HISTORY_HPP_
+#define SIGNUM_HISTORY_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "signum/circular_buffer.hpp"
+
+namespace signum
+{
+namespace circular_buffer
+{
+
+/*!
+ * \brief A class to keep the recent history of a buffer and capture it to disk
+ *
+ * A history owns a reader of a buffer and consumes items on a thread of its
+ * own, keeping a lookback window of the newest items. When triggered it
+ * writes the window and the items that follow to a file. Each write covers
+ * every item available at once, which the mirrored mapping keeps contiguous.
+ *
+ * The buffer must hold the lookback window and the slack the history lets
+ * accumulate before it discards items, as well as whatever the writer and
+ * any other readers need. The history waits on the event_fd of the reader,
+ * so the reader must be in the process of the writer.
+ */
+template<typename T>
+class history
+{
+public:
+    using size_type = std::size_t;
+
+    /*!
+     * \brief Keep the history of a buffer
+     * \param rd the reader to keep the history of
+     * \param lookback the number of items to keep
+     * \param slack the items allowed past the window before discarding any,
+     *              which defaults to an eighth of the window
+     */
+    history(reader<T> && rd, size_type lookback, size_type slack = 0);
+
+    history(const history &) = delete;
+
+    history & operator=(const history &) = delete;
+
+    ~history();
+
+    //! Returns the number of items kept before a trigger
+    size_type lookback() const { return d_lookback; }
+
+    /*!
+     * \brief Capture the window and the items that follow it to a file
+     *
+     * The window ends just before an absolute item index, such as the index()
+     * of the writer or of the reader that detected an event. Items older than
+     * the window are only discarded once the slack is used up, so the window
+     * is complete if the trigger is made within the slack of the index. A
+     * trigger made while a capture is in progress waits for it to finish,
+     * and its window starts no earlier than the end of that capture.
+     *
+     * \param path the file to create or truncate
+     * \param post the number of items to capture after the window
+     * \param index the absolute index of the first item after the window
+     * \returns the number of items written, or an exception on an error
+     */
+    std::future<size_type> trigger(const std::string & path, size_type post,
+                                   size_type index);
+
+private:
+    struct capture
+    {
+        std::string path;
+        size_type post;
+        size_type index;
+        std::promise<size_type> result;
+    };
+
+    void run();
+
+    bool wait(size_type n, bool triggers);
+
+    size_type write(int fd, size_type n);
+
+    void save(capture & cap);
+
+    reader<T> d_reader;
+    size_type d_lookback;
+    size_type d_slack;
+    std::mutex d_mutex;
+    std::condition_variable d_idle;
+    std::unique_ptr<capture> d_capture; //!< the trigger being handled, if any
+    size_type d_waiting; //!< the number of triggers waiting for a capture
+    std::atomic<bool> d_stop;
+    int d_wake; //!< an eventfd signalled on a trigger or stop request
+    int d_event; //!< the event_fd of the reader
+    size_type d_threshold; //!< the threshold of the event_fd
+    std::thread d_thread;
+};
+
+template<typename T>
+history<T>::history(reader<T> && rd, size_type lookback, size_type slack)
+    : d_reader(std::move(rd)),
+      d_lookback(lookback),
+      d_slack(slack != 0 ? slack : std::max<size_type>(lookback / 8, 1)),
+      d_waiting(0),
+      d_stop(false),
+      d_wake(-1),
+      d_event(-1),
+      d_threshold(0)
+{
+    if (d_lookback + d_slack > d_reader.max_size())
+        throw std::invalid_argument(std::string(__func__) +
+                                    ": the window exceeds the buffer");
+
+    d_wake = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (d_wake == -1)
+        throw std::system_error(errno, std::system_category());
+
+    d_thread = std::thread(&history::run, this);
+}
+
+template<typename T>
+history<T>::~history()
+{
+    d_stop.store(true, std::memory_order_relaxed);
+    const uint64_t one = 1;
+    (void) ::write(d_wake, &one, sizeof(one));
+    d_thread.join();
+    ::close(d_wake);
+}
+
+template<typename T>
+std::future<typename history<T>::size_type>
+history<T>::trigger(const std::string & path, size_type post, size_type index)
+{
+    std::unique_lock<std::mutex> lock(d_mutex);
+    ++d_waiting;
+    d_idle.wait(lock, [this]{ return !d_capture; });
+    --d_waiting;
+
+    d_capture.reset(new capture{path, post, index, std::promise<size_type>()});
+    auto result = d_capture->result.get_future();
+    d_idle.notify_all();
+
+    const uint64_t one = 1;
+    (void) ::write(d_wake, &one, sizeof(one));
+
+    return result;
+}
+
+template<typename T>
+void history<T>::run()
+{
+    do
+    {
+        std::unique_lock<std::mutex> lock(d_mutex);
+        while (d_capture)
+        {
+            // The capture is kept until it is saved, so triggers made in the
+            // meantime wait for it. Its signal is consumed here so that save()
+            // is only woken by items or a stop request.
+            uint64_t signals;
+            (void) ::read(d_wake, &signals, sizeof(signals));
+            lock.unlock();
+            save(*d_capture);
+            lock.lock();
+
+            d_capture.reset();
+            d_idle.notify_all();
+
+            // Hand over to a waiting trigger before discarding anything, as
+            // its window may be among the items
+            d_idle.wait(lock, [this]{ return d_capture || d_waiting == 0; });
+        }
+
+        // Discard the oldest items only once the slack is used up, and never
+        // while a trigger is being made, as its window may be among them
+        const auto size = d_reader.size();
+        if (size >= d_lookback + d_slack)
+            d_reader.consume(size - d_lookback);
+    }
+    while (wait(d_lookback + d_slack, true));
+
+    // Fail any trigger made while stopping
+    std::lock_guard<std::mutex> lock(d_mutex);
+    if (d_capture)
+        d_capture->result.set_exception(std::make_exception_ptr(
+            std::runtime_error("history: destroyed while capturing")));
+}
+
+/*!
+ * Waits until the reader holds a number of items, or a trigger is made if
+ * triggers are handled. The signal of a trigger is otherwise left for run().
+ * Returns false once the history is stopped.
+ */
+template<typename T>
+bool history<T>::wait(size_type n, bool triggers)
+{
+    // The event_fd is only replaced when the threshold changes
+    if (n != d_threshold)
+    {
+        d_event = d_reader.event_fd(n);
+        d_threshold = n;
+    }
+
+    pollfd fds[2] = { { d_event, POLLIN, 0 }, { d_wake, POLLIN, 0 } };
+    nfds_t count = 2;
+    while (!d_stop.load(std::memory_order_relaxed))
+    {
+        if (::poll(fds, count, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::system_category());
+        }
+
+        if (count == 2 && (fds[1].revents & POLLIN))
+        {
+            if (d_stop.load(std::memory_order_relaxed))
+                return false;
+            if (!triggers)
+            {
+                count = 1;
+                continue;
+            }
+
+            uint64_t signals;
+            (void) ::read(d_wake, &signals, sizeof(signals));
+            return true;
+        }
+
+        if (fds[0].revents & POLLIN)
+            return true;
+    }
+
+    return false;
+}
+
+template<typename T>
+typename history<T>::size_type history<T>::write(int fd, size_type n)
+{
+    // Write the available items with as few system calls as possible
+    const auto data = reinterpret_cast<const char *>(d_reader.begin());
+    const size_type bytes = n * sizeof(T);
+
+    for (size_type done = 0; done < bytes; )
+    {
+        const auto count = ::write(fd, data + done, bytes - done);
+        if (count == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::system_category());
+        }
+        done += count;
+    }
+
+    d_reader.consume(n);
+
+    return n;
+}
+
+template<typename T>
+void history<T>::save(capture & cap)
+{
+    int fd = ::open(cap.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        cap.result.set_exception(std::make_exception_ptr(
+            std::system_error(errno, std::system_category(), cap.path)));
+        return;
+    }
+
+    try
+    {
+        // Skip to the start of the window, which is shorter if the trigger
+        // came too late to keep its oldest items
+        const auto first = cap.index - std::min(cap.index, d_lookback);
+        while (d_reader.index() < first)
+        {
+            const auto skip = std::min(d_reader.size(), first - d_reader.index());
+            d_reader.consume(skip);
+            if (d_reader.index() < first && !wait(1, false))
+                throw std::runtime_error("history: destroyed while capturing");
+        }
+
+        size_type written = 0;
+        const auto last = cap.index + cap.post;
+        while (d_reader.index() < last)
+        {
+            const auto n = std::min(d_reader.size(), last - d_reader.index());
+            written += write(fd, n);
+            if (d_reader.index() < last && !wait(1, false))
+                throw std::runtime_error("history: destroyed while capturing");
+        }
+
+        const int status = ::close(fd);
+        fd = -1;
+        if (status == -1)
+            throw std::system_error(errno, std::system_category(), cap.path);
+
+        cap.result.set_value(written);
+    }
+    catch (...)
+    {
+        if (fd != -1)
+            ::close(fd);
+        cap.result.set_exception(std::current_exception());
+    }
+}
+
+} // namespace circular_buffer
+} // namespace signum
+
+#endif /* SIGNUM_HISTORY_HPP_ */
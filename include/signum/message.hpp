@@ -7,15 +7,72 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
+#include "signum/utility/endian.hpp"
+
 namespace signum
 {
 
 namespace zeromq { class socket; }
 
+class message_view;
+
+class message_batch;
+
+namespace detail
+{
+//! An allocator that leaves bytes uninitialized when a vector grows, since
+//! a message always overwrites the space it grows by
+template<typename T>
+struct uninitialized_allocator : std::allocator<T>
+{
+  template<typename U> struct rebind { using other = uninitialized_allocator<U>; };
+
+  uninitialized_allocator() = default;
+
+  template<typename U>
+  uninitialized_allocator(const uninitialized_allocator<U>&) noexcept { }
+
+  template<typename U>
+  void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+
+  template<typename U, typename... Args>
+  void construct(U* p, Args&&... args)
+  {
+    ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+  }
+};
+} /* namespace detail */
+
+/**
+ * \brief A trait describing the fields of a struct serialized as a whole
+ *
+ * A specialization has a static constexpr function get() returning a tuple of
+ * pointers to the numeric or boolean data members to serialize, in order. The
+ * SIGNUM_MESSAGE_FIELDS macro defines one.
+ */
+template<typename T> struct message_fields;
+
+//! Describe the fields of a struct, which must be used at global scope
+#define SIGNUM_MESSAGE_FIELDS(type, ...)                               \
+  namespace signum {                                                   \
+  template<> struct message_fields<type>                               \
+  {                                                                    \
+    static constexpr auto get() { return std::make_tuple(__VA_ARGS__); } \
+  };                                                                   \
+  }
+
+//! Returns the number of bytes a struct with described fields serializes to
+template<typename T> constexpr std::size_t message_size();
+
 /**
  * \brief A class for serializing and deserializing messages
  */
@@ -23,6 +80,7 @@ class message
 {
 public:
   friend class zeromq::socket;
+  friend class message_batch;
 
   //! The binary message formats
   enum class formats : uint8_t
@@ -97,6 +155,12 @@ public:
   //! Reset the message so it can be serialized again
   void reset() { m_pos = 0; }
 
+  //! Reserve space for a message of count bytes
+  void reserve(std::size_t count) { m_data.reserve(count); }
+
+  //! Returns the number of bytes the message can hold without allocating
+  std::size_t capacity() const { return m_data.capacity(); }
+
   //! Serialize a nil type
   message& serialize();
 
@@ -133,41 +197,93 @@ public:
   //! Serialize a double precision floating point type
   message& serialize(double value);
 
+  //! Serialize a string type
+  message& serialize(const std::string& value);
+
+  //! Serialize a null terminated string type
+  message& serialize(const char* value);
+
+  /*!
+   * \brief Serialize a block of numeric values as an array
+   *
+   * Each element is encoded at the full width of its type, so the block is
+   * encoded by a single loop into space grown once without initializing it.
+   */
+  template<typename T>
+  message& serialize(const T* data, std::size_t count);
+
+  //! Serialize a block of bytes as a binary type
+  message& serialize_bin(const void* data, std::size_t size);
+
+  //! Serialize the header of an array of count objects which must follow it
+  message& serialize_array(std::size_t count);
+
+  /*!
+   * \brief Serialize a struct with described fields as an array
+   *
+   * Every field is encoded at the full width of its type, so the layout and
+   * size are fixed and the fields are written without branches.
+   *
+   * \sa message_fields
+   */
+  template<typename T> message& serialize_fields(const T& value);
+
+  //! Serialize the header of a map of count key and value pairs which must follow it
+  message& serialize_map(std::size_t count);
+
   //! Serialize any supported type
   template<typename T>
   message& operator<<(T value) { return serialize(value); }
 
+  //! Serialize a string type
+  message& operator<<(const std::string& value) { return serialize(value); }
+
   //! Deserialize a nil type
   message& deserialize();
 
   //! Deserialize any supported type
   template<typename T> message& deserialize(T& value);
 
-  //! Deserialize any supported type
-  template<typename T>
-  message& operator>>(T& value) { return deserialize(value); }
+  //! Deserialize a numeric type without throwing, returning false on an error
+  template<typename T> bool try_deserialize(T& value);
 
-private:
-  uint64_t deserialize_format(uint64_t value, uint8_t format);
-
-  uint32_t deserialize_format(uint32_t value, uint8_t format);
+  //! Deserialize a struct with described fields
+  template<typename T> message& deserialize_fields(T& value);
 
-  uint16_t deserialize_format(uint16_t value, uint8_t format);
+  //! Deserialize an array of exactly count numeric values
+  template<typename T> message& deserialize(T* data, std::size_t count);
 
-  uint8_t deserialize_format(uint8_t value, uint8_t format);
+  /*!
+   * \brief Deserialize a binary type without copying it
+   * \param data set to the bytes, valid until the message is modified
+   * \param size set to the number of bytes
+   */
+  message& deserialize_bin(const uint8_t*& data, std::size_t& size);
 
-  int64_t deserialize_format(int64_t value, uint8_t format);
+  //! Deserialize the header of an array
+  message& deserialize_array(std::size_t& count);
 
-  int32_t deserialize_format(int32_t value, uint8_t format);
+  //! Deserialize the header of a map
+  message& deserialize_map(std::size_t& count);
 
-  int16_t deserialize_format(int16_t value, uint8_t format);
+  //! Skip the next object, including every element of an array or map
+  message& skip();
 
-  int8_t deserialize_format(int8_t value, uint8_t format);
+  /*!
+   * \brief Returns the positions of the objects that follow in one pass
+   * \param count the most objects to index, or every one that remains
+   * \sa seek()
+   */
+  std::vector<std::size_t> index(std::size_t count = SIZE_MAX) const;
 
-  double deserialize_format(double value, uint8_t format);
+  //! Move the extract position to a position such as one from index()
+  message& seek(std::size_t position);
 
-  float deserialize_format(float value, uint8_t format);
+  //! Deserialize any supported type
+  template<typename T>
+  message& operator>>(T& value) { return deserialize(value); }
 
+private:
   uint8_t* data() { return m_data.data(); }
 
   const uint8_t* data() const { return m_data.data(); }
@@ -185,32 +301,478 @@ private:
   //! Insert data into the message buffer
   template<typename T> void insert(const T& data);
 
-  //! Extract a single byte from the message buffer without advancing position
+  //! Insert a format and a length of the smallest width holding it, where a
+  //! format repeated for the next width marks one the type does not have
+  void insert_length(std::size_t length, formats fix, std::size_t fixmax,
+                     formats len8, formats len16, formats len32);
+
+  //! Returns a view of the message from the extract position
+  message_view view() const;
+
+  std::vector<uint8_t, detail::uninitialized_allocator<uint8_t>> m_data; //!< message buffer
+  std::size_t m_pos; //!< extract position
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * \brief A class for deserializing messages held in external memory
+ *
+ * A message view neither owns nor copies the memory it deserializes, so a
+ * received frame or a span of a buffer can be parsed in place. The memory must
+ * outlive the view.
+ */
+class message_view
+{
+public:
+  friend class message;
+
+  //! Construct a view of size bytes of serialized data
+  message_view(const void* data, std::size_t size);
+
+  //! Returns the number of bytes deserialized
+  std::size_t position() const { return m_pos; }
+
+  //! Returns the number of bytes left to deserialize
+  std::size_t remaining() const { return m_size - m_pos; }
+
+  //! Returns the serialized data
+  const uint8_t* data() const { return m_data; }
+
+  //! Returns the size of the serialized data
+  std::size_t size() const { return m_size; }
+
+  //! Deserialize a nil type
+  message_view& deserialize();
+
+  //! Deserialize any supported type
+  template<typename T> message_view& deserialize(T& value);
+
+  /*!
+   * \brief Deserialize a numeric type without throwing
+   * \returns false, leaving the position unchanged, if the next object is
+   *          not a number that fits the type or is truncated
+   */
+  template<typename T> bool try_deserialize(T& value);
+
+  /*!
+   * \brief Deserialize a struct with described fields
+   *
+   * Fields encoded at full width, as serialize_fields does, are copied from a
+   * fixed layout. Any other encoding of the array is deserialized field by field.
+   *
+   * \sa message_fields
+   */
+  template<typename T> message_view& deserialize_fields(T& value);
+
+  //! Deserialize an array of exactly count numeric values
+  template<typename T> message_view& deserialize(T* data, std::size_t count);
+
+  /*!
+   * \brief Deserialize a binary type without copying it
+   * \param data set to the bytes, valid as long as the viewed memory
+   * \param size set to the number of bytes
+   */
+  message_view& deserialize_bin(const uint8_t*& data, std::size_t& size);
+
+  //! Deserialize the header of an array
+  message_view& deserialize_array(std::size_t& count);
+
+  //! Deserialize the header of a map
+  message_view& deserialize_map(std::size_t& count);
+
+  //! Skip the next object, including every element of an array or map
+  message_view& skip();
+
+  /*!
+   * \brief Returns the positions of the objects that follow in one pass
+   *
+   * Objects are skipped without being decoded, so an index lets a reader
+   * seek straight to the objects it needs.
+   *
+   * \param count the most objects to index, or every one that remains
+   * \sa seek()
+   */
+  std::vector<std::size_t> index(std::size_t count = SIZE_MAX) const;
+
+  //! Move the extract position to a position such as one from index()
+  message_view& seek(std::size_t position);
+
+  //! Deserialize any supported type
+  template<typename T>
+  message_view& operator>>(T& value) { return deserialize(value); }
+
+private:
+  using formats = message::formats;
+
+  message_view(const uint8_t* data, std::size_t size, std::size_t pos);
+
+  //! Deserialize each described field of a struct in turn
+  template<typename T, std::size_t... I>
+  void deserialize_each(T& value, std::size_t count, std::index_sequence<I...>);
+
+  //! Decode a number and advance past it, or return why it can not be
+  template<typename T> const char* decode(T& value);
+
+  //! Extract and advance past a length following a format byte, where a
+  //! format repeated for the next width marks one the type does not have
+  std::size_t extract_length(uint8_t format, formats fix, uint8_t fixmask,
+                             formats len8, formats len16, formats len32);
+
+  //! Advance past count bytes which must be in the view
+  void advance(uint64_t count);
+
+  //! Extract a single byte from the view without advancing position
   uint8_t extract();
 
-  //! Extract data from the message buffer without advancing position
+  //! Extract data from the view without advancing position
   template<typename T> T& extract(T&);
 
-  std::vector<uint8_t> m_data;           //!< message buffer
-  std::vector<uint8_t>::size_type m_pos; //!< extract position
+  const uint8_t* m_data; //!< serialized data
+  std::size_t m_size;    //!< size of the serialized data
+  std::size_t m_pos;     //!< extract position
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 
+namespace detail
+{
+//! The unsigned integer type with the size of another type
+template<std::size_t N> struct unsigned_type;
+template<> struct unsigned_type<1> { using type = uint8_t; };
+template<> struct unsigned_type<2> { using type = uint16_t; };
+template<> struct unsigned_type<4> { using type = uint32_t; };
+template<> struct unsigned_type<8> { using type = uint64_t; };
+
+//! The format of an array element encoded at the full width of its type
+template<typename T> struct element_format;
+template<> struct element_format<uint8_t>  { static constexpr uint8_t value = 0xcc; };
+template<> struct element_format<uint16_t> { static constexpr uint8_t value = 0xcd; };
+template<> struct element_format<uint32_t> { static constexpr uint8_t value = 0xce; };
+template<> struct element_format<uint64_t> { static constexpr uint8_t value = 0xcf; };
+template<> struct element_format<int8_t>   { static constexpr uint8_t value = 0xd0; };
+template<> struct element_format<int16_t>  { static constexpr uint8_t value = 0xd1; };
+template<> struct element_format<int32_t>  { static constexpr uint8_t value = 0xd2; };
+template<> struct element_format<int64_t>  { static constexpr uint8_t value = 0xd3; };
+template<> struct element_format<float>    { static constexpr uint8_t value = 0xca; };
+template<> struct element_format<double>   { static constexpr uint8_t value = 0xcb; };
+
+//! Swap between host and big endian byte order inline
+inline uint8_t swap_big_endian(uint8_t value) { return value; }
+inline uint16_t swap_big_endian(uint16_t value) { return utility::htobe(value); }
+inline uint32_t swap_big_endian(uint32_t value) { return utility::htobe(value); }
+inline uint64_t swap_big_endian(uint64_t value) { return utility::htobe(value); }
+
+//! Returns the type of a data member
+template<typename C, typename M> M member_type(M C::*);
+
+//! Returns the number of bytes of a field encoded at full width
+template<typename M>
+constexpr std::size_t field_size() { return 1 + sizeof(M); }
+
+template<>
+constexpr std::size_t field_size<bool>() { return 1; }
+
+//! Returns the number of bytes of an array header of count objects
+constexpr std::size_t array_header_size(std::size_t count)
+{
+  return count < 16 ? 1 : 3;
+}
+
+template<typename T>
+using field_sequence =
+    std::make_index_sequence<std::tuple_size<decltype(message_fields<T>::get())>::value>;
+
+template<typename T, std::size_t I>
+using field_type = decltype(member_type(std::get<I>(message_fields<T>::get())));
+
+template<typename T, std::size_t... I>
+constexpr std::size_t fields_size(std::index_sequence<I...>)
+{
+  const std::size_t sizes[] = { array_header_size(sizeof...(I)), field_size<field_type<T, I>>()... };
+
+  std::size_t size = 0;
+  for (auto n : sizes)
+    size += n;
+
+  return size;
+}
+
+//! Encode a field at full width and return the end of it
+template<typename M>
+uint8_t* encode_field(uint8_t* out, const M& value)
+{
+  using word = typename unsigned_type<sizeof(M)>::type;
+
+  word bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  bits = swap_big_endian(bits);
+  out[0] = element_format<M>::value;
+  std::memcpy(out + 1, &bits, sizeof(bits));
+
+  return out + sizeof(bits) + 1;
+}
+
+inline uint8_t* encode_field(uint8_t* out, bool value)
+{
+  out[0] = value ? 0xc3 : 0xc2;
+  return out + 1;
+}
+
+//! Returns nonzero unless a field is encoded at full width, and its end
+template<typename M>
+uint8_t check_field(const uint8_t*& in)
+{
+  const uint8_t mismatch = in[0] ^ element_format<M>::value;
+  in += field_size<M>();
+  return mismatch;
+}
+
+template<>
+inline uint8_t check_field<bool>(const uint8_t*& in)
+{
+  const uint8_t mismatch = (in[0] & 0xfe) ^ 0xc2;
+  in += 1;
+  return mismatch;
+}
+
+//! Decode a field encoded at full width and return the end of it
+template<typename M>
+const uint8_t* decode_field(const uint8_t* in, M& value)
+{
+  using word = typename unsigned_type<sizeof(M)>::type;
+
+  word bits;
+  std::memcpy(&bits, in + 1, sizeof(bits));
+  bits = swap_big_endian(bits);
+  std::memcpy(&value, &bits, sizeof(bits));
+
+  return in + sizeof(bits) + 1;
+}
+
+inline const uint8_t* decode_field(const uint8_t* in, bool& value)
+{
+  value = (in[0] & 1) != 0;
+  return in + 1;
+}
+
+template<typename T, std::size_t... I>
+void encode_fields(uint8_t* out, const T& value, std::index_sequence<I...>)
+{
+  constexpr auto fields = message_fields<T>::get();
+  constexpr std::size_t count = sizeof...(I);
+  static_assert(count <= std::numeric_limits<uint16_t>::max(), "too many fields");
+
+  if (count < 16)
+  {
+    *out++ = 0x90 | count;
+  }
+  else
+  {
+    *out++ = 0xdc;
+    *out++ = count >> 8;
+    *out++ = count & 0xff;
+  }
+
+  using expand = int[];
+  (void) expand{ 0, (out = encode_field(out, value.*std::get<I>(fields)), 0)... };
+}
+
+template<typename T, std::size_t... I>
+bool check_fields(const uint8_t* in, std::index_sequence<I...>)
+{
+  constexpr std::size_t count = sizeof...(I);
+
+  uint8_t mismatch;
+  if (count < 16)
+  {
+    mismatch = *in++ ^ (0x90 | count);
+  }
+  else
+  {
+    mismatch = (in[0] ^ 0xdc) | (in[1] ^ (count >> 8)) | (in[2] ^ (count & 0xff));
+    in += 3;
+  }
+
+  using expand = int[];
+  (void) expand{ 0, (mismatch |= check_field<field_type<T, I>>(in), 0)... };
+
+  return mismatch == 0;
+}
+
+template<typename T, std::size_t... I>
+void decode_fields(const uint8_t* in, T& value, std::index_sequence<I...>)
+{
+  constexpr auto fields = message_fields<T>::get();
+
+  in += array_header_size(sizeof...(I));
+
+  using expand = int[];
+  (void) expand{ 0, (in = decode_field(in, value.*std::get<I>(fields)), 0)... };
+}
+} /* namespace detail */
+
+template<typename T>
+constexpr std::size_t message_size()
+{
+  return detail::fields_size<T>(detail::field_sequence<T>());
+}
+
+inline message_view message::view() const
+{
+  return message_view(m_data.data(), m_data.size(), m_pos);
+}
+
+template<typename T>
+message& message::serialize(const T* data, std::size_t count)
+{
+  using word = typename detail::unsigned_type<sizeof(T)>::type;
+  constexpr uint8_t format = detail::element_format<T>::value;
+  constexpr std::size_t stride = 1 + sizeof(T);
+
+  serialize_array(count);
+
+  // Grow once without initializing the space, so each element is written
+  // in a single pass by a loop without branches. The interleaved format
+  // bytes and byte swaps keep the loop scalar.
+  const auto pos = m_data.size();
+  m_data.resize(pos + count * stride);
+
+  uint8_t* out = m_data.data() + pos;
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    word value;
+    std::memcpy(&value, &data[i], sizeof(value));
+    value = detail::swap_big_endian(value);
+    out[i * stride] = format;
+    std::memcpy(&out[i * stride + 1], &value, sizeof(value));
+  }
+
+  return *this;
+}
+
+template<typename T>
+message& message::serialize_fields(const T& value)
+{
+  constexpr std::size_t size = message_size<T>();
+
+  // The whole struct is written into space grown once
+  const auto pos = m_data.size();
+  m_data.resize(pos + size);
+
+  detail::encode_fields(m_data.data() + pos, value, detail::field_sequence<T>());
+
+  return *this;
+}
+
+template<typename T>
+message& message::deserialize_fields(T& value)
+{
+  auto v = view();
+
+  v.deserialize_fields(value);
+  m_pos = v.position();
+
+  return *this;
+}
+
 template<typename T>
 message& message::deserialize(T& value)
 {
-  auto format = extract();
+  auto v = view();
+
+  v.deserialize(value);
+  m_pos = v.position();
+
+  return *this;
+}
+
+template<typename T>
+bool message::try_deserialize(T& value)
+{
+  auto v = view();
 
-  m_pos++;
+  const bool result = v.try_deserialize(value);
+  m_pos = v.position();
+
+  return result;
+}
+
+template<typename T>
+message& message::deserialize(T* data, std::size_t count)
+{
+  auto v = view();
+
+  v.deserialize(data, count);
+  m_pos = v.position();
+
+  return *this;
+}
+
+template<typename T>
+void message::insert(const T& data)
+{
+  const uint8_t* first = reinterpret_cast<const uint8_t*>(&data);
+
+  m_data.insert(std::end(m_data), first, first + sizeof(data));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+message_view& message_view::deserialize(T& value)
+{
+  const char* error = decode(value);
+
+  if (error != nullptr)
+    throw message::deserialize_error(__func__, error);
+
+  return *this;
+}
+
+template<typename T>
+bool message_view::try_deserialize(T& value)
+{
+  return decode(value) == nullptr;
+}
+
+template<typename T, std::size_t... I>
+void message_view::deserialize_each(T& value, std::size_t count, std::index_sequence<I...>)
+{
+  constexpr auto fields = message_fields<T>::get();
+
+  if (count != sizeof...(I))
+    throw message::deserialize_error(__func__, "field count mismatch");
+
+  using expand = int[];
+  (void) expand{ 0, (deserialize(value.*std::get<I>(fields)), 0)... };
+}
+
+template<typename T>
+message_view& message_view::deserialize_fields(T& value)
+{
+  constexpr std::size_t size = message_size<T>();
+  const auto sequence = detail::field_sequence<T>();
+
+  if (m_size - m_pos >= size && detail::check_fields<T>(m_data + m_pos, sequence))
+  {
+    detail::decode_fields(m_data + m_pos, value, sequence);
+    m_pos += size;
+    return *this;
+  }
+
+  // Another encoding of the same fields is deserialized one at a time
+  const auto start = m_pos;
 
   try
   {
-    value = deserialize_format(value, format);
+    std::size_t count;
+    deserialize_array(count);
+    deserialize_each(value, count, sequence);
   }
-  catch (const deserialize_error&)
+  catch (const message::deserialize_error&)
   {
-    m_pos--;
+    m_pos = start;
     throw;
   }
 
@@ -218,25 +780,62 @@ message& message::deserialize(T& value)
 }
 
 template<>
-message& message::deserialize<bool>(bool& value);
+message_view& message_view::deserialize<bool>(bool& value);
+
+template<>
+message_view& message_view::deserialize<std::string>(std::string& value);
 
 template<typename T>
-void message::insert(const T& data)
+message_view& message_view::deserialize(T* data, std::size_t count)
 {
-  const uint8_t* first = reinterpret_cast<const uint8_t*>(&data);
+  using word = typename detail::unsigned_type<sizeof(T)>::type;
+  constexpr uint8_t format = detail::element_format<T>::value;
+  constexpr std::size_t stride = 1 + sizeof(T);
 
-  m_data.insert(std::end(m_data), first, first + sizeof(data));
+  const auto start = m_pos;
+
+  try
+  {
+    std::size_t size;
+    deserialize_array(size);
+    if (size != count)
+      throw message::deserialize_error(__func__, "array size mismatch");
+
+    // Elements encoded at full width are decoded in place, others as usual
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      if (m_size - m_pos >= stride && m_data[m_pos] == format)
+      {
+        word value;
+        std::memcpy(&value, m_data + m_pos + 1, sizeof(value));
+        value = detail::swap_big_endian(value);
+        std::memcpy(&data[i], &value, sizeof(value));
+        m_pos += stride;
+      }
+      else
+      {
+        deserialize(data[i]);
+      }
+    }
+  }
+  catch (const message::deserialize_error&)
+  {
+    m_pos = start;
+    throw;
+  }
+
+  return *this;
 }
 
 template<typename T>
-T& message::extract(T& data)
+T& message_view::extract(T& data)
 {
-  if (m_data.size() - m_pos < sizeof(data))
-    throw deserialize_error(__func__, "message size insufficient");
+  if (m_size - m_pos < sizeof(data))
+    throw message::deserialize_error(__func__, "message size insufficient");
 
   uint8_t* result = reinterpret_cast<uint8_t*>(&data);
 
-  std::copy_n(&m_data[m_pos], sizeof(data), result);
+  std::copy_n(m_data + m_pos, sizeof(data), result);
 
   return data;
 }
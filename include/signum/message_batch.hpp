@@ -0,0 +1,157 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#ifndef SIGNUM_MESSAGE_BATCH_HPP_
+#define SIGNUM_MESSAGE_BATCH_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "signum/message.hpp"
+
+namespace signum
+{
+
+/**
+ * \brief A class for framing many messages into one buffer
+ *
+ * Each message is appended as a record of a four byte big endian length
+ * followed by the message, so a batch is sent with one system call and one
+ * frame. A batch is sent once it is full or once its oldest message reaches
+ * an age limit, and is then cleared to be reused without allocating.
+ *
+ * \sa message_records
+ */
+class message_batch
+{
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  //! The number of bytes preceding each message
+  static constexpr std::size_t prefix_size = sizeof(uint32_t);
+
+  /*!
+   * \brief Construct an empty batch
+   * \param max_size the most bytes of records in the batch
+   * \param max_age the longest a message should wait to be sent
+   */
+  message_batch(std::size_t max_size, clock_type::duration max_age);
+
+  /*!
+   * \brief Append a message to the batch
+   * \returns false, leaving the batch unchanged, if the batch must be sent
+   *          to make room for the message
+   * \throws std::length_error if the message can never fit in a batch
+   */
+  bool append(const message& msg);
+
+  //! Checks whether the oldest message has reached the age limit
+  bool expired(clock_type::time_point now = clock_type::now()) const
+  {
+    return !empty() && now - m_first >= m_max_age;
+  }
+
+  //! Checks whether there are no messages in the batch
+  bool empty() const { return m_count == 0; }
+
+  //! Returns the number of messages in the batch
+  std::size_t count() const { return m_count; }
+
+  //! Returns the records of the batch
+  const uint8_t* data() const { return m_data.data(); }
+
+  //! Returns the number of bytes of records in the batch
+  std::size_t size() const { return m_data.size(); }
+
+  //! Remove every message, keeping the space of the batch
+  void clear();
+
+private:
+  std::vector<uint8_t> m_data;    //!< the records
+  std::size_t m_max_size;         //!< the most bytes of records
+  clock_type::duration m_max_age; //!< the longest a message waits
+  clock_type::time_point m_first; //!< the time the first message was appended
+  std::size_t m_count;            //!< the number of messages
+};
+
+/**
+ * \brief A range of the messages framed by a batch
+ *
+ * Each record is viewed in place, so no message is copied. A truncated record
+ * throws a deserialize_error when it is reached.
+ */
+class message_records
+{
+public:
+  //! An iterator over the records of a batch
+  class iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = message_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const message_view*;
+    using reference = message_view;
+
+    //! Returns a view of the current message
+    message_view operator*() const
+    {
+      return message_view(m_data + m_pos + message_batch::prefix_size, length());
+    }
+
+    iterator& operator++()
+    {
+      m_pos += message_batch::prefix_size + length();
+      return *this;
+    }
+
+    iterator operator++(int)
+    {
+      iterator result(*this);
+      ++*this;
+      return result;
+    }
+
+    bool operator==(const iterator& other) const
+    {
+      return m_data == other.m_data && m_pos == other.m_pos;
+    }
+
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+
+  private:
+    friend class message_records;
+
+    iterator(const uint8_t* data, std::size_t size, std::size_t pos) :
+        m_data(data), m_size(size), m_pos(pos)
+    { }
+
+    //! Returns the length of the current message, which must be complete
+    std::size_t length() const;
+
+    const uint8_t* m_data;
+    std::size_t m_size;
+    std::size_t m_pos;
+  };
+
+  //! Construct a range of the records of a received batch
+  message_records(const void* data, std::size_t size) :
+      m_data(static_cast<const uint8_t*>(data)), m_size(size)
+  { }
+
+  iterator begin() const { return iterator(m_data, m_size, 0); }
+
+  iterator end() const { return iterator(m_data, m_size, m_size); }
+
+private:
+  const uint8_t* m_data;
+  std::size_t m_size;
+};
+
+} /* namespace signum */
+
+#endif /* SIGNUM_MESSAGE_BATCH_HPP_ */
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#ifndef SIGNUM_MESSAGE_DECODER_HPP_
+#define SIGNUM_MESSAGE_DECODER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace signum
+{
+
+/**
+ * \brief A class for decoding messages that arrive in fragments
+ *
+ * A message decoder is fed whatever bytes have arrived and returns the
+ * objects they complete one at a time. Bytes of an incomplete object header
+ * are kept until the rest arrives, so a fragment may end anywhere. The
+ * payload of a string, binary or extension object is returned in chunks
+ * pointing into the fragments as they arrive, so a large message is parsed
+ * without first buffering it whole.
+ */
+class message_decoder
+{
+public:
+  //! The results of decoding
+  enum class status
+  {
+    object,    //!< an object or a payload chunk was decoded
+    need_more, //!< every byte was consumed and more are needed
+    error      //!< the next byte is not a valid format
+  };
+
+  //! The kinds of decoded objects
+  enum class kinds : uint8_t
+  {
+    nil,
+    boolean,
+    uinteger,
+    sinteger,
+    floating,
+    str,      //!< a string header followed by chunks of its length
+    bin,      //!< a binary header followed by chunks of its length
+    ext,      //!< an extension header followed by chunks of its length
+    array,    //!< an array header followed by its elements
+    map,      //!< a map header followed by its keys and values
+    chunk     //!< part of the payload of a string, binary or extension
+  };
+
+  //! A decoded object
+  struct object
+  {
+    kinds kind;
+    union
+    {
+      bool boolean;
+      uint64_t uinteger;
+      int64_t sinteger;
+      double floating;
+      uint64_t length;     //!< the payload bytes or the number of elements
+    };
+    int8_t type;           //!< the type of an extension
+    const uint8_t* data;   //!< the bytes of a chunk
+    std::size_t size;      //!< the number of bytes of a chunk
+  };
+
+  //! Construct a decoder at the start of a message
+  message_decoder();
+
+  /*!
+   * \brief Decode the next object or payload chunk
+   * \param data the bytes that have arrived
+   * \param size the number of bytes that have arrived
+   * \param used set to the number of bytes consumed
+   * \param obj set to the decoded object when the status is object
+   */
+  status next(const void* data, std::size_t size, std::size_t& used, object& obj);
+
+  //! Checks whether every object started has been decoded in full
+  bool complete() const
+  {
+    return m_header_size == 0 && m_payload == 0 && m_pending.empty();
+  }
+
+  //! Returns the payload bytes left of the current string, binary or extension
+  uint64_t payload() const { return m_payload; }
+
+  //! Returns the number of arrays and maps being decoded
+  std::size_t depth() const { return m_pending.size(); }
+
+  //! Discard any partial object and start a new message
+  void reset();
+
+private:
+  //! Decode the buffered header into an object
+  void decode_header(object& obj);
+
+  //! Account for a complete object in the containers holding it
+  void finish();
+
+  uint8_t m_header[10];            //!< bytes of a partial header
+  std::size_t m_header_size;       //!< number of bytes of the partial header
+  uint64_t m_payload;              //!< bytes left of the current payload
+  std::vector<uint64_t> m_pending; //!< objects left of each open container
+};
+
+} /* namespace signum */
+
+#endif /* SIGNUM_MESSAGE_DECODER_HPP_ */
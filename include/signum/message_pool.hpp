@@ -0,0 +1,90 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#ifndef SIGNUM_MESSAGE_POOL_HPP_
+#define SIGNUM_MESSAGE_POOL_HPP_
+
+#include <cstddef>
+#include <memory>
+
+#include "signum/message.hpp"
+
+namespace signum
+{
+
+/**
+ * \brief A pool of messages reserved ahead of time and reused
+ *
+ * Messages acquired from a pool are returned to it when their pointer is
+ * destroyed, keeping the space they have grown, so a steady flow of messages
+ * allocates nothing once the pool is warm. Each thread keeps a small cache of
+ * free messages and only takes a lock to move messages between its cache and
+ * the pool.
+ *
+ * A message may be released by a thread other than the one that acquired it.
+ * Messages a thread cached from a destroyed pool are freed the next time the
+ * thread acquires or releases a message, or when it exits. A message that
+ * grew to more than max_growth times the reservation is freed when released
+ * instead of being kept.
+ */
+class message_pool
+{
+  struct state;
+  class thread_cache;
+
+public:
+  //! Returns a message to the pool it was acquired from
+  class deleter
+  {
+  public:
+    deleter() = default;
+
+    void operator()(message* msg) const;
+
+  private:
+    friend class message_pool;
+
+    explicit deleter(const std::shared_ptr<state>& pool) : m_pool(pool) { }
+
+    std::shared_ptr<state> m_pool;
+  };
+
+  //! A pointer to a message that returns it to the pool when destroyed
+  using pointer = std::unique_ptr<message, deleter>;
+
+  //! The most free messages a thread keeps from each pool
+  static constexpr std::size_t cache_size = 32;
+
+  //! The most capacity a released message keeps, in multiples of the reservation
+  static constexpr std::size_t max_growth = 2;
+
+  /*!
+   * \brief Construct a pool of messages
+   * \param reserve the bytes each message holds without allocating
+   * \param count the number of messages to allocate now
+   */
+  explicit message_pool(std::size_t reserve, std::size_t count = cache_size);
+
+  //! A pool cannot be copy constructed
+  message_pool(const message_pool&) = delete;
+
+  //! A pool cannot be copy assigned
+  message_pool& operator=(const message_pool&) = delete;
+
+  //! Returns the bytes each message holds without allocating
+  std::size_t reserve() const;
+
+  //! Acquire an empty message, allocating one only if none are free
+  pointer acquire();
+
+private:
+  //! Returns the cache of the calling thread
+  static thread_cache& local_cache();
+
+  std::shared_ptr<state> m_state;
+};
+
+} /* namespace signum */
+
+#endif /* SIGNUM_MESSAGE_POOL_HPP_ */
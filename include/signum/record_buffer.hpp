@@ -0,0 +1,199 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#ifndef SIGNUM_RECORD_BUFFER_HPP_
+#define SIGNUM_RECORD_BUFFER_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "signum/buffer.hpp"
+#include "signum/circular_buffer.hpp"
+
+namespace signum
+{
+namespace circular_buffer
+{
+
+class record_reader;
+
+namespace detail
+{
+//! The header preceding each record
+struct record_header
+{
+    uint64_t size; //!< the number of bytes in the record
+};
+
+//! Records start on this boundary so headers and payloads are aligned
+constexpr size_t record_alignment = sizeof(record_header);
+
+//! Returns the number of bytes a record occupies in the buffer
+inline size_t record_stride(size_t n)
+{
+    return sizeof(record_header) +
+           (n + record_alignment - 1) / record_alignment * record_alignment;
+}
+} // namespace detail
+
+/*!
+ * \brief A class to write variable length records to a buffer
+ *
+ * Each record is preceded by a small header holding its length and is padded
+ * to keep the next header aligned. Since the buffer is mirrored, a record is
+ * always contiguous even where it wraps around, so records are filled and
+ * read in place without copies.
+ *
+ * Records can not be partially dropped, so the writer always blocks on slow
+ * readers whatever the overrun mode of the options.
+ */
+class record_writer
+{
+public:
+    using size_type = std::size_t;
+
+    //! Construct a buffer holding at least n bytes of records and headers
+    explicit record_writer(size_type n, const options & opts = options());
+
+    //! Create a named buffer that record readers in other processes may open
+    record_writer(const std::string & name, size_type n,
+                  const options & opts = options());
+
+    //! Make a reader of the records written after it is made
+    record_reader make_reader();
+
+    //! Returns the largest record that fits in the buffer
+    size_type max_record_size() const
+    {
+        return d_writer.max_size() / detail::record_alignment *
+               detail::record_alignment - sizeof(detail::record_header);
+    }
+
+    /*!
+     * \brief Wait for space for a record and return it to be filled in place
+     * \param n the largest number of bytes the record may hold
+     * \throws std::length_error if the record can never fit in the buffer
+     */
+    buffer<uint8_t> prepare(size_type n);
+
+    //! Publish the prepared record holding n bytes, at most those prepared
+    void commit(size_type n);
+
+    //! Copy a record into the buffer, waiting for space
+    void write(const void * data, size_type n)
+    {
+        auto rec = prepare(n);
+        if (n != 0)
+            std::memcpy(rec.begin(), data, n);
+        commit(n);
+    }
+
+private:
+    static options record_options(options opts)
+    {
+        opts.overrun = overrun_modes::block;
+        return opts;
+    }
+
+    writer<uint8_t> d_writer;
+    size_type d_reserved; //!< bytes reserved by prepare, or zero
+};
+
+/*!
+ * \brief A class to read variable length records from a buffer
+ *
+ * A record is only visible once it has been committed in full.
+ */
+class record_reader
+{
+public:
+    using size_type = std::size_t;
+
+    //! Open a named buffer created by a record writer in another process
+    explicit record_reader(const std::string & name) : d_reader(name) { }
+
+    //! Checks whether there are no records to read
+    bool empty() const { return d_reader.empty(); }
+
+    //! Returns the next record, which must exist
+    buffer<uint8_t> front()
+    {
+        const auto header = reinterpret_cast<const detail::record_header *>(d_reader.begin());
+        return buffer<uint8_t>(d_reader.begin() + sizeof(*header), header->size);
+    }
+
+    //! Consume the next record, which must exist
+    void pop()
+    {
+        const auto header = reinterpret_cast<const detail::record_header *>(d_reader.begin());
+        d_reader.consume(detail::record_stride(header->size));
+    }
+
+    //! Wait for a record
+    void wait() { d_reader.wait(sizeof(detail::record_header)); }
+
+    //! Wait for a record, returning false on a timeout
+    template<typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep,Period> & timeout)
+    {
+        return d_reader.wait_for(sizeof(detail::record_header), timeout) != 0;
+    }
+
+private:
+    friend class record_writer;
+
+    explicit record_reader(reader<uint8_t> && rd) : d_reader(std::move(rd)) { }
+
+    reader<uint8_t> d_reader;
+};
+
+inline record_writer::record_writer(size_type n, const options & opts)
+    : d_writer(n, record_options(opts)),
+      d_reserved(0)
+{ }
+
+inline record_writer::record_writer(const std::string & name, size_type n,
+                                    const options & opts)
+    : d_writer(name, n, record_options(opts)),
+      d_reserved(0)
+{ }
+
+inline record_reader record_writer::make_reader()
+{
+    return record_reader(d_writer.make_reader());
+}
+
+inline buffer<uint8_t> record_writer::prepare(size_type n)
+{
+    if (n > max_record_size())
+        throw std::length_error(std::string(__func__) + ": record exceeds the buffer");
+
+    d_reserved = detail::record_stride(n);
+    d_writer.wait(d_reserved);
+
+    return buffer<uint8_t>(d_writer.begin() + sizeof(detail::record_header), n);
+}
+
+inline void record_writer::commit(size_type n)
+{
+    // Padding of the prepared record may be used, but nothing beyond it
+    if (detail::record_stride(n) > d_reserved)
+        throw std::length_error(std::string(__func__) + ": record exceeds the prepared size");
+
+    auto header = reinterpret_cast<detail::record_header *>(d_writer.begin());
+    header->size = n;
+
+    // The header and payload are published together by a single update
+    d_writer.consume(detail::record_stride(n));
+    d_reserved = 0;
+}
+
+} // namespace circular_buffer
+} // namespace signum
+
+#endif /* SIGNUM_RECORD_BUFFER_HPP_ */
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#ifndef SIGNUM_WORK_QUEUE_HPP_
+#define SIGNUM_WORK_QUEUE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "signum/circular_buffer.hpp"
+
+namespace signum
+{
+namespace circular_buffer
+{
+
+/*!
+ * \brief A buffer shared by any number of producers and consumers
+ *
+ * Producers and consumers claim disjoint blocks of items by advancing a
+ * reservation index with a compare and swap, fill or process them in place,
+ * and then commit them. Commits are made in the order the blocks were claimed,
+ * so consumers see a single ordered stream and producers only reuse space
+ * once every block before it has been released. Blocks are always contiguous
+ * since the buffer is mirrored.
+ *
+ * Waiting uses the same policy and futex events as the single producer
+ * buffers, so no lock is taken. The queue is local to a process.
+ *
+ * The indices are aligned to cache lines, so a queue allocated dynamically
+ * needs an allocation that honours alignof(work_queue), such as the aligned
+ * operator new of C++17.
+ */
+template<typename T>
+class work_queue
+{
+public:
+    using value_type = T;
+    using size_type  = std::size_t;
+    using pointer    = T *;
+
+    //! A block of items claimed by a producer or consumer
+    class block
+    {
+    public:
+        block() : d_begin(nullptr), d_size(0), d_index(0) { }
+
+        pointer begin() const { return d_begin; }
+
+        pointer end() const { return d_begin + d_size; }
+
+        size_type size() const { return d_size; }
+
+        bool empty() const { return d_size == 0; }
+
+        //! Returns the absolute index of the first item in the stream
+        size_type index() const { return d_index; }
+
+    private:
+        friend class work_queue;
+
+        block(pointer begin, size_type size, size_type index)
+            : d_begin(begin), d_size(size), d_index(index)
+        { }
+
+        pointer d_begin;
+        size_type d_size;
+        size_type d_index;
+    };
+
+    //! Construct a queue holding at least n items
+    explicit work_queue(size_type n, const options & opts = options());
+
+    work_queue(const work_queue &) = delete;
+
+    work_queue & operator=(const work_queue &) = delete;
+
+    //! Returns the maximum number of items in the queue
+    size_type max_size() const { return capacity() - 1; }
+
+    //! Wait for space and claim a block of n items to produce
+    block acquire_write(size_type n);
+
+    //! Claim a block of n items to produce if there is space, or an empty block
+    block try_acquire_write(size_type n);
+
+    //! Publish a produced block after every block claimed before it
+    void commit_write(const block & blk);
+
+    //! Wait for and claim a block of n items to consume
+    block acquire_read(size_type n);
+
+    //! Wait for a block of n items to consume, or return an empty block
+    template<typename Rep, typename Period>
+    block acquire_read_for(size_type n,
+                           const std::chrono::duration<Rep,Period> & timeout);
+
+    //! Claim a block of n items to consume if available, or an empty block
+    block try_acquire_read(size_type n);
+
+    //! Release a consumed block after every block claimed before it
+    void commit_read(const block & blk);
+
+private:
+    //! An index kept on its own cache line to avoid false sharing
+    struct alignas(64) index
+    {
+        std::atomic<size_type> value{0};
+    };
+
+    static_assert(sizeof(index) == 64 && alignof(index) == 64,
+                  "an index must fill one cache line");
+
+    size_type capacity() const { return d_impl->d_size / sizeof(T); }
+
+    pointer at(size_type pos) const
+    {
+        return static_cast<pointer>(d_impl->d_base) + pos % capacity();
+    }
+
+    //! Returns the space for producers after a reservation index
+    size_type space(size_type pos) const
+    {
+        return max_size() - (pos - d_read_commit.value.load(std::memory_order_acquire));
+    }
+
+    //! Returns the items for consumers after a reservation index
+    size_type items(size_type pos) const
+    {
+        return d_write_commit.value.load(std::memory_order_acquire) - pos;
+    }
+
+    //! Claim n items from a reservation index limited by a number of items
+    template<typename Available>
+    block claim(index & reserve, size_type n, detail::event & ev,
+                Available available, std::chrono::steady_clock::time_point deadline,
+                bool wait);
+
+    block claim_write(size_type n, std::chrono::steady_clock::time_point deadline,
+                      bool wait)
+    {
+        return claim(d_write_reserve, n, d_impl->d_control->read_event,
+                     [this](size_type pos) { return space(pos); }, deadline, wait);
+    }
+
+    block claim_read(size_type n, std::chrono::steady_clock::time_point deadline,
+                     bool wait)
+    {
+        return claim(d_read_reserve, n, d_impl->d_control->write_event,
+                     [this](size_type pos) { return items(pos); }, deadline, wait);
+    }
+
+    //! Wait for the blocks before one to commit and then commit it
+    void commit(index & committed, const block & blk, detail::event & ev);
+
+    std::unique_ptr<detail::impl> d_impl;
+    wait_policy d_wait_policy;
+    index d_write_reserve;
+    index d_write_commit; //!< items visible to consumers
+    index d_read_reserve;
+    index d_read_commit;  //!< items whose space producers may reuse
+};
+
+template<typename T>
+work_queue<T>::work_queue(size_type n, const options & opts)
+    : d_impl(new detail::impl(n, sizeof(T), opts)),
+      d_wait_policy(opts.wait)
+{
+    if (opts.overrun != overrun_modes::block)
+        throw std::invalid_argument(std::string(__func__) +
+                                    ": work queues never drop items");
+}
+
+template<typename T>
+template<typename Available>
+typename work_queue<T>::block
+work_queue<T>::claim(index & reserve, size_type n, detail::event & ev,
+                     Available available,
+                     std::chrono::steady_clock::time_point deadline, bool wait)
+{
+    if (n == 0 || n > max_size())
+        throw std::length_error(std::string(__func__) + ": invalid block size");
+
+    auto pos = reserve.value.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        if (available(pos) >= n)
+        {
+            if (reserve.value.compare_exchange_weak(pos, pos + n,
+                                                    std::memory_order_relaxed))
+                return block(at(pos), n, pos);
+            continue;
+        }
+
+        if (!wait)
+            return block();
+
+        // Another thread may claim the items first, so reload and retry
+        const bool ready = d_impl->wait(ev, d_wait_policy, [&]{
+            pos = reserve.value.load(std::memory_order_relaxed);
+            return available(pos) >= n;
+        }, deadline);
+
+        if (!ready)
+            return block();
+    }
+}
+
+template<typename T>
+void work_queue<T>::commit(index & committed, const block & blk, detail::event & ev)
+{
+    const auto pos = blk.index();
+
+    // Blocks claimed earlier by other threads commit first
+    d_impl->wait(ev, d_wait_policy, [&]{
+        return committed.value.load(std::memory_order_acquire) == pos;
+    }, std::chrono::steady_clock::time_point::max());
+
+    d_impl->notify(committed.value, pos + blk.size(), ev);
+}
+
+template<typename T>
+typename work_queue<T>::block work_queue<T>::acquire_write(size_type n)
+{
+    return claim_write(n, std::chrono::steady_clock::time_point::max(), true);
+}
+
+template<typename T>
+typename work_queue<T>::block work_queue<T>::try_acquire_write(size_type n)
+{
+    return claim_write(n, std::chrono::steady_clock::time_point::max(), false);
+}
+
+template<typename T>
+void work_queue<T>::commit_write(const block & blk)
+{
+    commit(d_write_commit, blk, d_impl->d_control->write_event);
+}
+
+template<typename T>
+typename work_queue<T>::block work_queue<T>::acquire_read(size_type n)
+{
+    return claim_read(n, std::chrono::steady_clock::time_point::max(), true);
+}
+
+template<typename T>
+template<typename Rep, typename Period>
+typename work_queue<T>::block
+work_queue<T>::acquire_read_for(size_type n,
+                                const std::chrono::duration<Rep,Period> & timeout)
+{
+    return claim_read(n, detail::deadline_after(timeout), true);
+}
+
+template<typename T>
+typename work_queue<T>::block work_queue<T>::try_acquire_read(size_type n)
+{
+    return claim_read(n, std::chrono::steady_clock::time_point::max(), false);
+}
+
+template<typename T>
+void work_queue<T>::commit_read(const block & blk)
+{
+    commit(d_read_commit, blk, d_impl->d_control->read_event);
+}
+
+} // namespace circular_buffer
+} // namespace signum
+
+#endif /* SIGNUM_WORK_QUEUE_HPP_ */
@@ -5,11 +5,12 @@
 #ifndef SIGNUM_ZEROMQ_SOCKET_HPP_
 #define SIGNUM_ZEROMQ_SOCKET_HPP_
 
+#include <functional>
 #include <memory>
 #include <stdexcept>
 #include <string>
 
-namespace signum { class message; }
+namespace signum { class message; class message_view; class message_batch; }
 
 namespace signum
 {
@@ -70,12 +71,25 @@ public:
    */
   socket& send(const signum::message& msg);
 
+  /*! \brief Sends a batch of messages on the socket as one frame
+   *  \param batch a batch of messages
+   *  \sa message_records
+   */
+  socket& send(const signum::message_batch& batch);
+
   /*! \brief Receives a message on the socket
    *  \param msg a message
    *  \sa send()
    */
   socket& recv(signum::message& msg);
 
+  /*! \brief Receives a message on the socket without copying it
+   *  \param handler a function called with a view of the received frame,
+   *                 which is only valid until the function returns
+   *  \sa send()
+   */
+  socket& recv(const std::function<void(signum::message_view&)>& handler);
+
 private:
   /*!
    * \brief Constructs a message socket
@@ -16,8 +16,25 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#include <unistd.h>   // for sysconf
-#include <sys/mman.h> // for mmap
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>         // for O_* constants
+#include <linux/futex.h>   // for FUTEX_*
+#include <sys/eventfd.h>   // for eventfd
+#include <sys/mman.h>      // for mmap, memfd_create, shm_open
+#include <sys/stat.h>      // for fstat
+#include <sys/syscall.h>   // for SYS_futex, SYS_mbind, SYS_getcpu
+#include <time.h>          // for timespec
+#include <unistd.h>        // for sysconf, ftruncate, syscall
 
 #include "signum/circular_buffer.hpp"
 #include "signum/math.hpp"
@@ -44,62 +61,739 @@ size_t system_page_size()
 #endif
 }
 
-void * allocate_mirrored_pages(size_t n)
+size_t huge_page_size(page_sizes pages)
+{
+    switch (pages)
+    {
+    case page_sizes::huge_2mb:
+        return size_t(1) << 21;
+    case page_sizes::huge_1gb:
+        return size_t(1) << 30;
+    default:
+        return system_page_size();
+    }
+}
+
+//! Round a number of items up so it ends on a page boundary
+size_t round_to_pages(size_t num_items, size_t item_size, size_t page_size)
+{
+    using signum::math::gcd;
+
+    const auto items_per_page = page_size / gcd(page_size, item_size);
+
+    if (num_items % items_per_page)
+        num_items = (num_items / items_per_page + 1) * items_per_page;
+
+    return num_items * item_size;
+}
+
+//! Create an anonymous file that is initialized to zero
+int create_file(size_t n, unsigned flags)
+{
+    using std::string;
+    using std::runtime_error;
+
+    int fd = memfd_create("signum::circular_buffer", MFD_CLOEXEC | flags);
+    if (fd == -1)
+        throw runtime_error(string(__func__) + ": memfd_create failed");
+
+    if (ftruncate(fd, static_cast<off_t>(n)) == -1)
+    {
+        close(fd);
+        throw runtime_error(string(__func__) + ": ftruncate failed");
+    }
+
+    return fd;
+}
+
+//! Map a region of a file twice so the second half mirrors the first
+void * allocate_mirrored_pages(int fd, size_t offset, size_t n, size_t page_size)
 {
     using std::string;
     using std::runtime_error;
 
     const int prot = PROT_READ | PROT_WRITE;
-    const int flags = MAP_SHARED | MAP_ANONYMOUS;
+    const int flags = MAP_SHARED | MAP_FIXED;
+
+    // Reserve a contiguous address range for both halves aligned to a page
+    const auto reserve = 2*n + page_size;
+    void * r = mmap(nullptr, reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r == MAP_FAILED)
+        throw runtime_error(string(__func__) + ": mmap failed");
+
+    const auto addr = reinterpret_cast<uintptr_t>(r);
+    const auto head = (page_size - addr % page_size) % page_size;
+    auto p = static_cast<char*>(r) + head;
+
+    if (head != 0)
+        munmap(r, head);
+    munmap(p + 2*n, reserve - head - 2*n);
+
+    for (auto q : { p, p + n })
+    {
+        if (mmap(q, n, prot, flags, fd, static_cast<off_t>(offset)) == MAP_FAILED)
+        {
+            munmap(p, 2*n);
+            throw runtime_error(string(__func__) + ": mmap failed");
+        }
+    }
+
+    return p;
+}
 
-    // Create an anonymous memory mapping that is initialized to zero
-    void * p = mmap(nullptr, 2*n, prot, flags, -1, 0);
-    if (p == MAP_FAILED)
-        throw runtime_error(string(__func__) + "mmap failed");
+//! Map an anonymous file of n bytes twice so the second half mirrors the first
+void * allocate_mirrored_pages(size_t n, size_t page_size, unsigned flags)
+{
+    const int fd = create_file(n, flags);
 
-    // Remap the pages so the second half mirrors the first
-    // FIXME remap_file_pages has been deprecated
-    if (remap_file_pages(static_cast<char*>(p) + n, n, 0, 0, 0) == -1)
+    void * p;
+    try
+    {
+        p = allocate_mirrored_pages(fd, 0, n, page_size);
+    }
+    catch (...)
     {
-        munmap(p, 2*n);;
-        throw runtime_error(string(__func__) + "remap_file_pages failed");
+        close(fd);
+        throw;
     }
 
-  return p;
+    // The mappings keep the file alive
+    close(fd);
+
+    return p;
 }
 
 void deallocate_mirrored_pages(void * p, std::size_t n)
 {
     munmap(static_cast<void*>(p), 2*n);
 }
+
+// Memory policy constants from linux/mempolicy.h, which is not always installed
+constexpr int mpol_preferred = 1;
+constexpr unsigned mpol_mf_move = 1 << 1;
+
+//! Returns whether the system has only one NUMA node, or no NUMA support
+bool single_node()
+{
+    char online[64] = { };
+    int fd = open("/sys/devices/system/node/online", O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return true;
+    const auto count = read(fd, online, sizeof(online) - 1);
+    close(fd);
+
+    // A single node is listed alone, as in "0\n"
+    return count <= 0 || std::string(online, count).find_first_of(",-") == std::string::npos;
+}
+
+void bind_mirrored_pages(void * p, size_t n, int node, bool move)
+{
+    using std::string;
+    using std::runtime_error;
+
+    constexpr size_t bits = CHAR_BIT * sizeof(unsigned long);
+    unsigned long mask[16] = { };
+
+    if (node < 0 || static_cast<size_t>(node) >= bits * 16)
+        throw runtime_error(string(__func__) + ": invalid node");
+    mask[node / bits] = 1ul << (node % bits);
+
+    const unsigned flags = move ? mpol_mf_move : 0;
+    if (syscall(SYS_mbind, p, 2*n, mpol_preferred, mask, bits * 16 + 1, flags) == -1)
+    {
+        // Without NUMA support, or where a sandbox forbids it, there is
+        // nothing to bind on a single node
+        const int error = errno;
+        if (node == 0 && (error == ENOSYS || error == EPERM || error == EINVAL) &&
+            single_node())
+            return;
+        throw std::system_error(error, std::system_category(),
+                                string(__func__) + ": mbind failed");
+    }
+}
+
+void lock_mirrored_pages(void * p, size_t n, size_t page_size)
+{
+    using std::string;
+
+    // Write to every page through both halves so that each page table entry
+    // is present and writable before the pages are locked
+    auto base = static_cast<volatile char *>(p);
+    for (size_t i = 0; i < 2*n; i += page_size)
+        base[i] = base[i];
+
+    if (mlock(p, 2*n) == -1)
+        throw std::system_error(errno, std::system_category(),
+                                string(__func__) + ": mlock failed");
+}
+
+//! Identifies an initialized control block of a named buffer
+constexpr uint32_t control_magic = 0x7369676e;
 } // namespace anonymous
 
 ////////////////////////////////////////////////////////////////////////////////
 
 namespace detail
 {
-impl::impl(size_t num_items, size_t item_size)
-    : d_read(0), d_write(0)
+constexpr size_t impl::max_readers;
+
+void futex_wait(std::atomic<uint32_t> & word, uint32_t expected, bool shared,
+                std::chrono::nanoseconds timeout)
 {
-    using signum::math::gcd;
+    using std::chrono::seconds;
+    using std::chrono::duration_cast;
+
+    const int op = shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE;
+
+    // The timeout is relative and measured against CLOCK_MONOTONIC
+    timespec ts;
+    timespec * tsp = nullptr;
+    if (timeout != std::chrono::nanoseconds::max())
+    {
+        const auto sec = duration_cast<seconds>(timeout);
+        ts.tv_sec = static_cast<time_t>(sec.count());
+        ts.tv_nsec = static_cast<long>((timeout - sec).count());
+        tsp = &ts;
+    }
+
+    // Spurious returns are handled by the caller rechecking its predicate
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, expected,
+            tsp, nullptr, 0);
+}
+
+void futex_wake(std::atomic<uint32_t> & word, bool shared)
+{
+    const int op = shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, INT_MAX,
+            nullptr, nullptr, 0);
+}
+
+std::ptrdiff_t read_some(int fd, void * data, size_t size)
+{
+    for (;;)
+    {
+        const ssize_t n = ::read(fd, data, size);
+        if (n >= 0)
+            return n;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return -1;
+        if (errno != EINTR)
+            throw std::system_error(errno, std::system_category());
+    }
+}
+
+std::ptrdiff_t write_some(int fd, const void * data, size_t size)
+{
+    for (;;)
+    {
+        const ssize_t n = ::write(fd, data, size);
+        if (n >= 0)
+            return n;
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return -1;
+        if (errno != EINTR)
+            throw std::system_error(errno, std::system_category());
+    }
+}
 
+impl::impl(size_t num_items, size_t item_size, const options & opts)
+    : d_base(nullptr), d_control(allocate_control()), d_header_size(0), d_owner(false),
+      d_wait_policy(opts.wait)
+{
     // Add an extra item to disambiguate full and empty conditions
     num_items += 1;
 
-    // Find the number of items required to end on a page boundary
-    const auto page_size = system_page_size();
-    const auto items_per_page = page_size / gcd(page_size, item_size);
+    // Try huge pages first and fall back to system pages if none are available
+    if (opts.pages != page_sizes::system)
+    {
+        const auto page_size = huge_page_size(opts.pages);
+        // The page size is encoded as its base two logarithm above bit 26
+        const unsigned encoding = __builtin_ctzl(page_size) << 26;
+        try
+        {
+            d_size = round_to_pages(num_items, item_size, page_size);
+            d_base = allocate_mirrored_pages(d_size, page_size,
+                                             MFD_HUGETLB | encoding);
+            d_page_size = page_size;
+        }
+        catch (const std::runtime_error &)
+        {
+            d_base = nullptr;
+        }
+    }
 
-    if (num_items % items_per_page)
-        num_items = (num_items / items_per_page + 1) * items_per_page;
+    if (d_base == nullptr)
+    {
+        d_page_size = system_page_size();
+        d_size = round_to_pages(num_items, item_size, d_page_size);
+        try
+        {
+            d_base = allocate_mirrored_pages(d_size, d_page_size, 0);
+        }
+        catch (...)
+        {
+            deallocate_control(d_control);
+            throw;
+        }
+    }
 
-    d_size = num_items * item_size;
-    d_base = allocate_mirrored_pages(d_size);
+    if (opts.node >= 0 || opts.lock)
+    {
+        try
+        {
+            if (opts.node >= 0)
+                bind_mirrored_pages(d_base, d_size, opts.node, false);
+            if (opts.lock)
+                lock_mirrored_pages(d_base, d_size, d_page_size);
+        }
+        catch (...)
+        {
+            deallocate_mirrored_pages(d_base, d_size);
+            deallocate_control(d_control);
+            throw;
+        }
+    }
+
+    initialize(item_size, opts.overrun);
+}
+
+impl::impl(const std::string & name, size_t num_items, size_t item_size,
+           const options & opts)
+    : d_base(nullptr), d_control(nullptr), d_name(name), d_owner(true),
+      d_wait_policy(opts.wait)
+{
+    using std::string;
+    using std::runtime_error;
+
+    // Add an extra item to disambiguate full and empty conditions
+    num_items += 1;
+
+    d_page_size = system_page_size();
+    d_size = round_to_pages(num_items, item_size, d_page_size);
+    d_header_size = round_to_pages(sizeof(control), 1, d_page_size);
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1)
+        throw runtime_error(string(__func__) + ": shm_open failed for " + name);
+
+    try
+    {
+        if (ftruncate(fd, static_cast<off_t>(d_header_size + d_size)) == -1)
+            throw runtime_error(string(__func__) + ": ftruncate failed");
+
+        void * p = mmap(nullptr, d_header_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+            throw runtime_error(string(__func__) + ": mmap failed");
+        d_control = static_cast<control*>(p);
+
+        try
+        {
+            d_base = allocate_mirrored_pages(fd, d_header_size, d_size, d_page_size);
+            if (opts.node >= 0)
+                bind_mirrored_pages(d_base, d_size, opts.node, false);
+            if (opts.lock)
+                lock_mirrored_pages(d_base, d_size, d_page_size);
+        }
+        catch (...)
+        {
+            if (d_base)
+                deallocate_mirrored_pages(d_base, d_size);
+            munmap(d_control, d_header_size);
+            throw;
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw;
+    }
+
+    close(fd);
+
+    // The file is zero filled, so the atomics begin in a valid state
+    initialize(item_size, opts.overrun);
+}
+
+impl::impl(const std::string & name, size_t item_size)
+    : d_base(nullptr), d_control(nullptr), d_name(name), d_owner(false)
+{
+    using std::string;
+    using std::runtime_error;
+
+    d_page_size = system_page_size();
+    d_header_size = round_to_pages(sizeof(control), 1, d_page_size);
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd == -1)
+        throw runtime_error(string(__func__) + ": shm_open failed for " + name);
+
+    try
+    {
+        struct stat st;
+        if (fstat(fd, &st) == -1)
+            throw runtime_error(string(__func__) + ": fstat failed");
+        if (static_cast<size_t>(st.st_size) <= d_header_size)
+            throw runtime_error(string(__func__) + ": " + name + " is not ready");
+
+        void * p = mmap(nullptr, d_header_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+            throw runtime_error(string(__func__) + ": mmap failed");
+        d_control = static_cast<control*>(p);
+
+        try
+        {
+            if (d_control->magic.load(std::memory_order_acquire) != control_magic)
+                throw runtime_error(string(__func__) + ": " + name + " is not ready");
+            // Readers may view the items as another type of a compatible size
+            const size_t writer_size = d_control->item_size;
+            if (item_size % writer_size != 0 && writer_size % item_size != 0)
+                throw runtime_error(string(__func__) + ": item size mismatch");
+
+            d_size = d_control->size;
+            d_base = allocate_mirrored_pages(fd, d_header_size, d_size, d_page_size);
+        }
+        catch (...)
+        {
+            munmap(d_control, d_header_size);
+            throw;
+        }
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+}
+
+void impl::initialize(size_t item_size, overrun_modes overrun)
+{
+    auto & ctrl = *d_control;
+
+    ctrl.item_size = static_cast<uint32_t>(item_size);
+    ctrl.size = d_size;
+    ctrl.overrun = static_cast<uint32_t>(overrun);
+    ctrl.overruns.store(0, std::memory_order_relaxed);
+    ctrl.num_readers.store(1, std::memory_order_relaxed);
+    for (auto ev : { &ctrl.read_event, &ctrl.write_event })
+    {
+        ev->sequence.store(0, std::memory_order_relaxed);
+        ev->waiters.store(0, std::memory_order_relaxed);
+    }
+    ctrl.write.store(0, std::memory_order_relaxed);
+    ctrl.high_water.store(0, std::memory_order_relaxed);
+    ctrl.write_blocked.store(0, std::memory_order_relaxed);
+
+    // The first reader is reserved so items written before it is made are kept
+    for (auto & index : ctrl.readers)
+    {
+        index.read.store(0, std::memory_order_relaxed);
+        index.overruns.store(0, std::memory_order_relaxed);
+        index.blocked.store(0, std::memory_order_relaxed);
+        index.item_size.store(item_size, std::memory_order_relaxed);
+        index.start.store(0, std::memory_order_relaxed);
+        index.state.store(reader_index::free, std::memory_order_relaxed);
+    }
+    ctrl.readers[0].state.store(reader_index::reserved, std::memory_order_relaxed);
+
+    ctrl.magic.store(control_magic, std::memory_order_release);
+}
+
+impl::control * impl::allocate_control()
+{
+    void * p = nullptr;
+    if (posix_memalign(&p, alignof(control), sizeof(control)) != 0)
+        throw std::bad_alloc();
+    return new (p) control;
+}
+
+void impl::deallocate_control(control * ctrl)
+{
+    ctrl->~control();
+    free(ctrl);
 }
 
 impl::~impl()
 {
     deallocate_mirrored_pages(d_base, d_size);
+
+    if (d_name.empty())
+    {
+        deallocate_control(d_control);
+    }
+    else
+    {
+        munmap(d_control, d_header_size);
+        if (d_owner)
+            shm_unlink(d_name.c_str());
+    }
+}
+
+reader_index * impl::attach(size_t item_size, size_t alignment)
+{
+    using std::string;
+    using std::runtime_error;
+
+    auto & ctrl = *d_control;
+
+    // The reserved index starts at zero, which is aligned for any type
+    unsigned expected = reader_index::reserved;
+    if (ctrl.readers[0].state.compare_exchange_strong(expected, reader_index::attached))
+    {
+        ctrl.readers[0].item_size.store(item_size, std::memory_order_relaxed);
+        return &ctrl.readers[0];
+    }
+
+    for (size_t i = 0; i < max_readers; ++i)
+    {
+        auto & index = ctrl.readers[i];
+
+        // Claim the index before positioning it, since readers in other
+        // processes may attach concurrently
+        expected = reader_index::free;
+        if (!index.state.compare_exchange_strong(expected, reader_index::attaching))
+            continue;
+
+        // Hold the slowest read index, which the writer can not pass, and
+        // publish it before choosing the start so the writer respects it from
+        // then on. The writer may briefly see it further behind than the
+        // buffer holds, which it treats as a full buffer.
+        const auto held = tail();
+        index.read.store(held, std::memory_order_relaxed);
+        index.start.store(held, std::memory_order_relaxed);
+        index.overruns.store(0, std::memory_order_relaxed);
+        index.blocked.store(0, std::memory_order_relaxed);
+        index.item_size.store(item_size, std::memory_order_relaxed);
+        index.state.store(reader_index::positioning, std::memory_order_seq_cst);
+
+        auto num = ctrl.num_readers.load(std::memory_order_seq_cst);
+        while (num < i + 1 && !ctrl.num_readers.compare_exchange_weak(num, i + 1))
+            ;
+
+        // Any space the writer took without seeing the index ends short of
+        // a full buffer past the write index loaded now, so the reader
+        // starts there
+        const auto start = ctrl.write.load(std::memory_order_seq_cst);
+        if (start % alignment != 0)
+        {
+            detach(&index);
+            throw std::invalid_argument(string(__func__) + ": misaligned reader");
+        }
+        index.start.store(start, std::memory_order_relaxed);
+        index.read.store(start, std::memory_order_release);
+        index.state.store(reader_index::attached, std::memory_order_release);
+
+        // The writer may be waiting on the index held before
+        wake(ctrl.read_event);
+
+        return &index;
+    }
+
+    throw runtime_error(string(__func__) + ": too many readers");
+}
+
+void impl::drop(size_t n)
+{
+    auto & ctrl = *d_control;
+
+    const auto max_size = (d_size / ctrl.item_size - 1) * ctrl.item_size;
+    if (n > max_size)
+        n = max_size;
+
+    // Every reader must have consumed up to here for n bytes to fit
+    const auto write = ctrl.write.load(std::memory_order_relaxed);
+    const auto needed = write + n - max_size;
+
+    const auto num = ctrl.num_readers.load(std::memory_order_acquire);
+    for (size_t i = 0; i < num; ++i)
+    {
+        auto & index = ctrl.readers[i];
+        // A positioning reader never reads the items it holds, which may be
+        // overwritten
+        const auto state = index.state.load(std::memory_order_acquire);
+        if (state != reader_index::reserved && state != reader_index::attached)
+            continue;
+
+        // A reader made after the needed index is never in the way
+        const auto start = index.start.load(std::memory_order_relaxed);
+        if (write - start <= write - needed)
+            continue;
+
+        // Keep the reader on a boundary of its own items, short of any item
+        // the writer has not finished
+        const size_t item_size = index.item_size.load(std::memory_order_relaxed);
+        auto limit = needed + (item_size - (needed - start) % item_size) % item_size;
+        if (limit - start > write - start)
+            limit -= item_size;
+
+        // The reader may be consuming concurrently, so only move it forward
+        auto read = index.read.load(std::memory_order_acquire);
+        while (write - read > write - limit)
+        {
+            if (index.read.compare_exchange_weak(read, limit,
+                    std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                index.overruns.fetch_add(limit - read, std::memory_order_relaxed);
+                ctrl.overruns.fetch_add(limit - read, std::memory_order_relaxed);
+                break;
+            }
+        }
+    }
+}
+
+void impl::detach(reader_index * index)
+{
+    index->state.store(reader_index::free, std::memory_order_release);
+
+    // The writer may be blocked on the detached reader
+    wake(d_control->read_event);
+}
+
+void impl::bind(int node, bool move)
+{
+    bind_mirrored_pages(d_base, d_size, node, move);
+}
+
+int impl::current_node()
+{
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == -1)
+        throw std::system_error(errno, std::system_category(),
+                                std::string(__func__) + ": getcpu failed");
+    return static_cast<int>(node);
+}
+
+void impl::prune_tags()
+{
+    const size_t first = tail();
+    while (!d_tags.empty() && d_tags.front().offset < first)
+        d_tags.pop_front();
+
+    d_num_tags.store(d_tags.size(), std::memory_order_release);
+}
+
+void impl::add_tag(tag t)
+{
+    std::lock_guard<std::mutex> lock(d_tag_mutex);
+
+    // Tags are usually added in order so this rarely moves any
+    auto it = std::upper_bound(d_tags.begin(), d_tags.end(), t.offset,
+        [](uint64_t offset, const tag & other) { return offset < other.offset; });
+    d_tags.insert(it, std::move(t));
+
+    prune_tags();
+}
+
+std::vector<tag> impl::tags(size_t first, size_t last)
+{
+    std::lock_guard<std::mutex> lock(d_tag_mutex);
+
+    // Once every reader has passed the tags the count returns to zero, so
+    // later calls skip the lock
+    prune_tags();
+
+    auto it = std::lower_bound(d_tags.begin(), d_tags.end(), first,
+        [](const tag & t, uint64_t offset) { return t.offset < offset; });
+
+    std::vector<tag> result;
+    for (; it != d_tags.end() && it->offset < last; ++it)
+        result.push_back(*it);
+
+    return result;
+}
+
+notifier * impl::open_notifier(const reader_index * index, size_t threshold)
+{
+    using std::string;
+    using std::runtime_error;
+
+    notifier * ntf = &d_notifiers[index - d_control->readers];
+
+    ntf->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ntf->fd == -1)
+        throw runtime_error(string(__func__) + ": eventfd failed");
+    ntf->threshold = threshold;
+    ntf->index = index;
+    ntf->state.store(notifier::idle, std::memory_order_release);
+
+    return ntf;
+}
+
+void impl::close_notifier(notifier * ntf)
+{
+    // Wait out a writer that is signalling before closing the descriptor
+    unsigned state = ntf->state.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        if (state == notifier::signalling)
+        {
+            relax();
+            state = ntf->state.load(std::memory_order_relaxed);
+        }
+        else if (ntf->state.compare_exchange_weak(state, notifier::closed,
+                                                  std::memory_order_acquire))
+        {
+            break;
+        }
+    }
+
+    if (state == notifier::armed)
+        d_armed.fetch_sub(1, std::memory_order_relaxed);
+
+    close(ntf->fd);
+    ntf->fd = -1;
+}
+
+void impl::arm(notifier * ntf)
+{
+    unsigned state = notifier::idle;
+    if (!ntf->state.compare_exchange_strong(state, notifier::armed,
+                                            std::memory_order_acq_rel))
+        return;
+
+    // Clear any signal the reader consumed below the threshold
+    uint64_t value;
+    while (::read(ntf->fd, &value, sizeof(value)) == sizeof(value))
+        ;
+
+    d_armed.fetch_add(1, std::memory_order_relaxed);
+
+    // Pairs with the fence in the writer's notify so that either the writer
+    // sees the notifier armed or it is seen here that items are available
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    signal();
+}
+
+void impl::signal()
+{
+    const size_t head = d_control->write.load(std::memory_order_acquire);
+
+    for (auto & ntf : d_notifiers)
+    {
+        unsigned state = ntf.state.load(std::memory_order_acquire);
+        if (state != notifier::armed)
+            continue;
+
+        const size_t read = ntf.index->read.load(std::memory_order_acquire);
+        if (head - read < ntf.threshold)
+            continue;
+
+        if (!ntf.state.compare_exchange_strong(state, notifier::signalling,
+                                               std::memory_order_acquire))
+            continue;
+
+        d_armed.fetch_sub(1, std::memory_order_relaxed);
+
+        const uint64_t value = 1;
+        (void) !::write(ntf.fd, &value, sizeof(value));
+
+        ntf.state.store(notifier::idle, std::memory_order_release);
+    }
 }
 
 } // namespace detail
@@ -2,7 +2,10 @@
  * Copyright 2015 C. Brett Witherspoon
  */
 
+#include <cstring>
 #include <limits>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 
 #include "signum/message.hpp"
@@ -185,251 +188,686 @@ message& message::serialize(double value)
   return *this;
 }
 
+message& message::serialize(const std::string& value)
+{
+  insert_length(value.size(), formats::fixstr, 31,
+                formats::str8, formats::str16, formats::str32);
+  m_data.insert(std::end(m_data), std::begin(value), std::end(value));
+  return *this;
+}
+
+message& message::serialize(const char* value)
+{
+  const auto size = std::strlen(value);
+
+  insert_length(size, formats::fixstr, 31,
+                formats::str8, formats::str16, formats::str32);
+  m_data.insert(std::end(m_data), value, value + size);
+  return *this;
+}
+
+message& message::serialize_bin(const void* data, std::size_t size)
+{
+  const uint8_t* first = static_cast<const uint8_t*>(data);
+
+  insert_length(size, formats::bin8, 0,
+                formats::bin8, formats::bin16, formats::bin32);
+  m_data.insert(std::end(m_data), first, first + size);
+  return *this;
+}
+
+message& message::serialize_array(std::size_t count)
+{
+  insert_length(count, formats::fixarray, 15,
+                formats::array16, formats::array16, formats::array32);
+  return *this;
+}
+
+message& message::serialize_map(std::size_t count)
+{
+  insert_length(count, formats::fixmap, 15,
+                formats::map16, formats::map16, formats::map32);
+  return *this;
+}
+
 message& message::deserialize()
 {
-  if (extract() != formats::nil)
-    throw deserialize_error(__func__, "failed to deserialize a nil object");
+  auto v = view();
 
-  m_pos++;
+  v.deserialize();
+  m_pos = v.position();
 
   return *this;
 }
 
-template<>
-message& message::deserialize<bool>(bool& value)
+message& message::deserialize_bin(const uint8_t*& data, std::size_t& size)
 {
-  uint8_t format = extract();
+  auto v = view();
 
-  if (format == formats::boolfalse)
-    value = false;
-  else if (format == formats::booltrue)
-    value = true;
-  else
-    throw deserialize_error(__func__, "failed to deserialize a boolean object");
+  v.deserialize_bin(data, size);
+  m_pos = v.position();
 
-  m_pos++;
+  return *this;
+}
+
+message& message::deserialize_array(std::size_t& count)
+{
+  auto v = view();
+
+  v.deserialize_array(count);
+  m_pos = v.position();
 
   return *this;
 }
 
-////////////////////////////////////////////////////////////////////////////////
+message& message::deserialize_map(std::size_t& count)
+{
+  auto v = view();
+
+  v.deserialize_map(count);
+  m_pos = v.position();
+
+  return *this;
+}
 
-uint64_t message::deserialize_format(uint64_t value, uint8_t format)
+message& message::skip()
 {
-  uint64_t result;
+  auto v = view();
 
-  if (format == formats::uint64)
-  {
-    result = utility::betoh(extract(value));
-    m_pos += sizeof(value);
-  }
-  else
-  {
-    result = deserialize_format(static_cast<uint32_t>(value), format);
-  }
+  v.skip();
+  m_pos = v.position();
+
+  return *this;
+}
 
-  return result;
+std::vector<std::size_t> message::index(std::size_t count) const
+{
+  return view().index(count);
 }
 
-uint32_t message::deserialize_format(uint32_t value, uint8_t format)
+message& message::seek(std::size_t position)
 {
-  uint32_t result;
+  auto v = view();
+
+  v.seek(position);
+  m_pos = v.position();
+
+  return *this;
+}
 
-  if (format == formats::uint32)
+message& message::operator=(message&& other)
+{
+  m_data = std::move(other.m_data);
+  m_pos = other.m_pos;
+  return *this;
+}
+
+void message::insert(uint8_t data)
+{
+  m_data.push_back(data);
+}
+
+void message::insert_length(std::size_t length, formats fix, std::size_t fixmax,
+                            formats len8, formats len16, formats len32)
+{
+  // A fixed format holds a length up to its maximum in its low bits
+  if (length <= fixmax && fix != len8)
   {
-    result = utility::betoh(extract(value));
-    m_pos += sizeof(value);
+    insert(fix | static_cast<uint8_t>(length));
+  }
+  else if (length <= std::numeric_limits<uint8_t>::max() && len8 != len16)
+  {
+    insert(len8);
+    insert(static_cast<uint8_t>(length));
+  }
+  else if (length <= std::numeric_limits<uint16_t>::max())
+  {
+    insert(len16);
+    insert(utility::htobe(static_cast<uint16_t>(length)));
+  }
+  else if (length <= std::numeric_limits<uint32_t>::max())
+  {
+    insert(len32);
+    insert(utility::htobe(static_cast<uint32_t>(length)));
   }
   else
   {
-    result = deserialize_format(static_cast<uint16_t>(value), format);
+    throw std::length_error(std::string(__func__) + ": object too large");
   }
+}
+
+void message::insert(formats data)
+{
+  constexpr bool predicate =
+      std::is_same<uint8_t, std::underlying_type<formats>::type>::value;
+  static_assert(predicate,
+      "underlying type of the format enum class is not uint8_t");
 
-  return result;
+  insert(static_cast<uint8_t>(data));
 }
 
-uint16_t message::deserialize_format(uint16_t value, uint8_t format)
+message::deserialize_error::deserialize_error(
+    const std::string& loc, const std::string& msg)
+        : std::runtime_error(loc + ": " + msg)
+{ }
+
+message::deserialize_error::deserialize_error(
+    const char* loc, const char* msg)
+        : deserialize_error(std::string(loc), std::string(msg))
+{ }
+
+////////////////////////////////////////////////////////////////////////////////
+
+message_view::message_view(const void* data, std::size_t size) :
+    message_view(static_cast<const uint8_t*>(data), size, 0)
+{ }
+
+message_view::message_view(const uint8_t* data, std::size_t size, std::size_t pos) :
+    m_data(data), m_size(size), m_pos(pos)
+{ }
+
+message_view& message_view::deserialize()
 {
-  uint16_t result;
+  if (extract() != formats::nil)
+    throw message::deserialize_error(__func__, "failed to deserialize a nil object");
 
-  if (format == formats::uint16)
-  {
-    result = utility::betoh(extract(value));
-    m_pos += sizeof(value);
-  }
+  m_pos++;
+
+  return *this;
+}
+
+template<>
+message_view& message_view::deserialize<bool>(bool& value)
+{
+  uint8_t format = extract();
+
+  if (format == formats::boolfalse)
+    value = false;
+  else if (format == formats::booltrue)
+    value = true;
   else
-  {
-    result = deserialize_format(static_cast<uint8_t>(value), format);
-  }
+    throw message::deserialize_error(__func__, "failed to deserialize a boolean object");
+
+  m_pos++;
+
+  return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+//! The kinds of numeric objects a format byte starts
+enum kinds : uint8_t
+{
+  unsupported = 0,
+  posfixint   = 1 << 0, //!< a positive integer held in the format byte
+  negfixint   = 1 << 1, //!< a negative integer held in the format byte
+  unsigned_   = 1 << 2, //!< an unsigned integer following the format byte
+  signed_     = 1 << 3, //!< a signed integer following the format byte
+  floating    = 1 << 4  //!< a floating point number following the format byte
+};
+
+//! The kind and width of the object a format byte starts
+struct format_entry
+{
+  uint8_t kind;
+  uint8_t width;
+};
+
+//! The entries of every format byte
+struct format_table
+{
+  format_entry entries[256];
+};
 
-  return result;
+constexpr format_table make_format_table()
+{
+  format_table table{};
+
+  for (unsigned n = 0x00; n < 0x80; ++n)
+    table.entries[n] = { posfixint, 0 };
+  for (unsigned n = 0xe0; n < 0x100; ++n)
+    table.entries[n] = { negfixint, 0 };
+
+  table.entries[0xcc] = { unsigned_, 1 };
+  table.entries[0xcd] = { unsigned_, 2 };
+  table.entries[0xce] = { unsigned_, 4 };
+  table.entries[0xcf] = { unsigned_, 8 };
+  table.entries[0xd0] = { signed_, 1 };
+  table.entries[0xd1] = { signed_, 2 };
+  table.entries[0xd2] = { signed_, 4 };
+  table.entries[0xd3] = { signed_, 8 };
+  table.entries[0xca] = { floating, 4 };
+  table.entries[0xcb] = { floating, 8 };
+
+  return table;
 }
 
-uint8_t message::deserialize_format(uint8_t value, uint8_t format)
+constexpr format_table numeric_formats = make_format_table();
+
+//! The kinds of object a numeric type accepts up to its own width
+template<typename T>
+constexpr uint8_t accepted_kinds()
 {
-  uint8_t result;
+  return std::is_floating_point<T>::value ? floating :
+         std::is_signed<T>::value ? posfixint | negfixint | signed_ :
+                                    posfixint | unsigned_;
+}
 
-  if (format == formats::uint8)
+template<typename T>
+constexpr const char* rejected()
+{
+  return std::is_floating_point<T>::value ? "failed to deserialize a floating point object" :
+         std::is_signed<T>::value ? "failed to deserialize a signed integer object" :
+                                    "failed to deserialize an unsigned integer object";
+}
+
+//! Load a big endian unsigned integer of a width, which may be zero
+inline uint64_t load(const uint8_t* data, uint8_t width)
+{
+  switch (width)
   {
-    result = extract(value);
-    m_pos += sizeof(value);
+  case 0:
+    return 0;
+  case 1:
+    return data[0];
+  case 2:
+  {
+    uint16_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return utility::betoh(value);
   }
-  else if (format < (1 << 7)) // fixint
+  case 4:
   {
-    result = format;
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return utility::betoh(value);
   }
-  else
+  default: // 8
   {
-    throw deserialize_error(__func__, "failed to deserialize a positive integer object");
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return utility::betoh(value);
+  }
   }
+}
+} /* namespace (anonymous) */
 
-  return result;
+template<typename T>
+const char* message_view::decode(T& value)
+{
+  if (m_pos == m_size)
+    return "message size insufficient";
+
+  // A single lookup finds the kind and width of any numeric format
+  const uint8_t format = m_data[m_pos];
+  const format_entry entry = numeric_formats.entries[format];
+
+  if ((entry.kind & accepted_kinds<T>()) == 0 || entry.width > sizeof(T))
+    return rejected<T>();
+
+  if (m_size - m_pos - 1 < entry.width)
+    return "message size insufficient";
+
+  const uint64_t bits = load(m_data + m_pos + 1, entry.width);
+
+  switch (entry.kind)
+  {
+  case posfixint:
+    value = static_cast<T>(format);
+    break;
+  case negfixint:
+    value = static_cast<T>(static_cast<int8_t>(format));
+    break;
+  case signed_:
+  {
+    // Sign extend from the encoded width
+    const unsigned shift = 64 - 8 * entry.width;
+    value = static_cast<T>(static_cast<int64_t>(bits << shift) >> shift);
+    break;
+  }
+  case floating:
+    if (entry.width == sizeof(float))
+    {
+      const uint32_t word = static_cast<uint32_t>(bits);
+      float result;
+      std::memcpy(&result, &word, sizeof(result));
+      value = static_cast<T>(result);
+    }
+    else
+    {
+      double result;
+      std::memcpy(&result, &bits, sizeof(result));
+      value = static_cast<T>(result);
+    }
+    break;
+  default: // unsigned
+    value = static_cast<T>(bits);
+    break;
+  }
+
+  m_pos += 1 + entry.width;
+
+  return nullptr;
 }
 
-int64_t message::deserialize_format(int64_t value, uint8_t format)
+template const char* message_view::decode(uint64_t&);
+template const char* message_view::decode(uint32_t&);
+template const char* message_view::decode(uint16_t&);
+template const char* message_view::decode(uint8_t&);
+template const char* message_view::decode(int64_t&);
+template const char* message_view::decode(int32_t&);
+template const char* message_view::decode(int16_t&);
+template const char* message_view::decode(int8_t&);
+template const char* message_view::decode(double&);
+template const char* message_view::decode(float&);
+
+template<>
+message_view& message_view::deserialize<std::string>(std::string& value)
 {
-  int64_t result;
+  const auto start = m_pos;
+  const auto format = extract();
+
+  m_pos++;
 
-  if (format == formats::int64)
+  try
   {
-    result = utility::betoh(extract(value));
-    m_pos += sizeof(value);
+    const auto size = extract_length(format, formats::fixstr, 0xe0,
+                                      formats::str8, formats::str16, formats::str32);
+    if (m_size - m_pos < size)
+      throw message::deserialize_error(__func__, "message size insufficient");
+
+    value.assign(reinterpret_cast<const char*>(m_data + m_pos), size);
+    m_pos += size;
   }
-  else
+  catch (const message::deserialize_error&)
   {
-    result = deserialize_format(static_cast<int32_t>(value), format);
+    m_pos = start;
+    throw;
   }
 
-  return result;
+  return *this;
 }
 
-int32_t message::deserialize_format(int32_t value, uint8_t format)
+message_view& message_view::deserialize_bin(const uint8_t*& data, std::size_t& size)
 {
-  int32_t result;
+  const auto start = m_pos;
+  const auto format = extract();
 
-  if (format == formats::int32)
+  m_pos++;
+
+  try
   {
-    result = utility::betoh(extract(value));
-    m_pos += sizeof(value);
+    const auto length = extract_length(format, formats::bin8, 0xff,
+                                        formats::bin8, formats::bin16, formats::bin32);
+    if (m_size - m_pos < length)
+      throw message::deserialize_error(__func__, "message size insufficient");
+
+    data = m_data + m_pos;
+    size = length;
+    m_pos += length;
   }
-  else
+  catch (const message::deserialize_error&)
   {
-    result = deserialize_format(static_cast<int16_t>(value), format);
+    m_pos = start;
+    throw;
   }
 
-  return result;
+  return *this;
 }
 
-int16_t message::deserialize_format(int16_t value, uint8_t format)
+message_view& message_view::deserialize_array(std::size_t& count)
 {
-  int16_t result;
+  const auto start = m_pos;
+  const auto format = extract();
+
+  m_pos++;
 
-  if (format == formats::int16)
+  try
   {
-    result = utility::betoh(extract(value));
-    m_pos += sizeof(value);
+    count = extract_length(format, formats::fixarray, 0xf0,
+                           formats::array16, formats::array16, formats::array32);
   }
-  else
+  catch (const message::deserialize_error&)
   {
-    result = deserialize_format(static_cast<int8_t>(value), format);
+    m_pos = start;
+    throw;
   }
 
-  return result;
+  return *this;
 }
 
-int8_t message::deserialize_format(int8_t value, uint8_t format)
+message_view& message_view::deserialize_map(std::size_t& count)
 {
-  int8_t result;
+  const auto start = m_pos;
+  const auto format = extract();
 
-  if (format == formats::int8)
-  {
-    result = extract(value);
-    m_pos += sizeof(value);
-  }
-  else if ((format & formats::negfixint) == formats::negfixint) // fixint
+  m_pos++;
+
+  try
   {
-    result = reinterpret_cast<int8_t&>(format);
+    count = extract_length(format, formats::fixmap, 0xf0,
+                           formats::map16, formats::map16, formats::map32);
   }
-  else
+  catch (const message::deserialize_error&)
   {
-    throw deserialize_error(__func__, "failed to deserialize a negative integer object");
+    m_pos = start;
+    throw;
   }
 
-  return result;
+  return *this;
 }
 
-double message::deserialize_format(double value, uint8_t format)
+message_view& message_view::skip()
 {
-  double result;
-
-  if (format == formats::float64)
-  {
-    result = utility::betoh(extract(value));
-    m_pos += sizeof(value);
-  }
-  else
-  {
-    result = deserialize_format(static_cast<float>(value), format);
+  const auto start = m_pos;
+
+  try
+  {
+    // Containers add their elements to the objects left rather than recursing
+    uint64_t pending = 1;
+
+    while (pending != 0)
+    {
+      --pending;
+
+      const uint8_t format = extract();
+      advance(1);
+
+      if (format < 0x80 || format >= 0xe0) // fixint
+        continue;
+
+      if (format < 0x90) // fixmap
+      {
+        pending += 2 * (format & 0x0f);
+        continue;
+      }
+
+      if (format < 0xa0) // fixarray
+      {
+        pending += format & 0x0f;
+        continue;
+      }
+
+      if (format < 0xc0) // fixstr
+      {
+        advance(format & 0x1f);
+        continue;
+      }
+
+      uint8_t len8;
+      uint16_t len16;
+      uint32_t len32;
+      uint64_t payload;
+
+      switch (static_cast<formats>(format))
+      {
+      case formats::nil:
+      case formats::boolfalse:
+      case formats::booltrue:
+        break;
+      case formats::uint8:
+      case formats::int8:
+        advance(1);
+        break;
+      case formats::uint16:
+      case formats::int16:
+        advance(2);
+        break;
+      case formats::uint32:
+      case formats::int32:
+      case formats::float32:
+        advance(4);
+        break;
+      case formats::uint64:
+      case formats::int64:
+      case formats::float64:
+        advance(8);
+        break;
+      case formats::fixext1:
+      case formats::fixext2:
+      case formats::fixext4:
+      case formats::fixext8:
+      case formats::fixext16:
+        advance(1 + (1u << (format - static_cast<uint8_t>(formats::fixext1))));
+        break;
+      case formats::str8:
+      case formats::bin8:
+        payload = extract(len8);
+        advance(1);
+        advance(payload);
+        break;
+      case formats::str16:
+      case formats::bin16:
+        payload = utility::betoh(extract(len16));
+        advance(2);
+        advance(payload);
+        break;
+      case formats::str32:
+      case formats::bin32:
+        payload = utility::betoh(extract(len32));
+        advance(4);
+        advance(payload);
+        break;
+      case formats::ext8:
+        payload = 1 + extract(len8);
+        advance(1);
+        advance(payload);
+        break;
+      case formats::ext16:
+        payload = 1 + utility::betoh(extract(len16));
+        advance(2);
+        advance(payload);
+        break;
+      case formats::ext32:
+        payload = 1 + uint64_t(utility::betoh(extract(len32)));
+        advance(4);
+        advance(payload);
+        break;
+      case formats::array16:
+        pending += utility::betoh(extract(len16));
+        advance(2);
+        break;
+      case formats::array32:
+        pending += utility::betoh(extract(len32));
+        advance(4);
+        break;
+      case formats::map16:
+        pending += 2 * uint64_t(utility::betoh(extract(len16)));
+        advance(2);
+        break;
+      case formats::map32:
+        pending += 2 * uint64_t(utility::betoh(extract(len32)));
+        advance(4);
+        break;
+      default:
+        throw message::deserialize_error(__func__, "invalid object format");
+      }
+    }
+  }
+  catch (const message::deserialize_error&)
+  {
+    m_pos = start;
+    throw;
   }
 
-  return result;
+  return *this;
 }
 
-float message::deserialize_format(float value, uint8_t format)
+std::vector<std::size_t> message_view::index(std::size_t count) const
 {
-  float result;
+  std::vector<std::size_t> positions;
 
-  if (format == formats::float32)
-  {
-    result = utility::betoh(extract(value));
-    m_pos += sizeof(value);
-  }
-  else
+  message_view view(*this);
+  while (positions.size() < count && view.remaining() != 0)
   {
-    throw deserialize_error(__func__, "failed to deserialize a floating point object");
+    positions.push_back(view.position());
+    view.skip();
   }
 
-  return result;
+  return positions;
 }
 
-message& message::operator=(message&& other)
+message_view& message_view::seek(std::size_t position)
 {
-  m_data = std::move(other.m_data);
-  m_pos = other.m_pos;
+  if (position > m_size)
+    throw message::deserialize_error(__func__, "position beyond the message");
+
+  m_pos = position;
+
   return *this;
 }
 
-void message::insert(uint8_t data)
+void message_view::advance(uint64_t count)
 {
-  m_data.push_back(data);
+  if (m_size - m_pos < count)
+    throw message::deserialize_error(__func__, "message size insufficient");
+
+  m_pos += count;
 }
 
-uint8_t message::extract()
+std::size_t message_view::extract_length(uint8_t format, formats fix, uint8_t fixmask,
+                                         formats len8, formats len16, formats len32)
 {
-  if (m_data.size() - m_pos < 1)
-    throw deserialize_error(__func__, "message size insufficient");
+  std::size_t length;
 
-  return m_data[m_pos];
+  if (fix != len8 && (format & fixmask) == fix)
+  {
+    length = format & static_cast<uint8_t>(~fixmask);
+  }
+  else if (format == len8 && len8 != len16)
+  {
+    uint8_t value;
+    length = extract(value);
+    m_pos += sizeof(value);
+  }
+  else if (format == len16)
+  {
+    uint16_t value;
+    length = utility::betoh(extract(value));
+    m_pos += sizeof(value);
+  }
+  else if (format == len32)
+  {
+    uint32_t value;
+    length = utility::betoh(extract(value));
+    m_pos += sizeof(value);
+  }
+  else
+  {
+    throw message::deserialize_error(__func__, "unexpected object format");
+  }
+
+  return length;
 }
 
-void message::insert(formats data)
+uint8_t message_view::extract()
 {
-  constexpr bool predicate =
-      std::is_same<uint8_t, std::underlying_type<formats>::type>::value;
-  static_assert(predicate,
-      "underlying type of the format enum class is not uint8_t");
+  if (m_size - m_pos < 1)
+    throw message::deserialize_error(__func__, "message size insufficient");
 
-  insert(static_cast<uint8_t>(data));
+  return m_data[m_pos];
 }
 
-message::deserialize_error::deserialize_error(
-    const std::string& loc, const std::string& msg)
-        : std::runtime_error(loc + ": " + msg)
-{ }
-
-message::deserialize_error::deserialize_error(
-    const char* loc, const char* msg)
-        : deserialize_error(std::string(loc), std::string(msg))
-{ }
-
 } /* namespace signum */
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "signum/message_batch.hpp"
+#include "signum/utility/endian.hpp"
+
+namespace signum {
+
+constexpr std::size_t message_batch::prefix_size;
+
+message_batch::message_batch(std::size_t max_size, clock_type::duration max_age) :
+    m_data(), m_max_size(max_size), m_max_age(max_age), m_first(), m_count(0)
+{
+  if (max_size <= prefix_size)
+    throw std::invalid_argument(std::string(__func__) + ": batch too small");
+
+  m_data.reserve(max_size);
+}
+
+bool message_batch::append(const message& msg)
+{
+  const auto size = msg.size();
+
+  if (size > m_max_size - prefix_size || size > std::numeric_limits<uint32_t>::max())
+    throw std::length_error(std::string(__func__) + ": message exceeds the batch");
+
+  if (m_data.size() + prefix_size + size > m_max_size)
+    return false;
+
+  if (m_count == 0)
+    m_first = clock_type::now();
+
+  // The batch never grows past the space reserved for it
+  const auto pos = m_data.size();
+  m_data.resize(pos + prefix_size + size);
+
+  const uint32_t length = utility::htobe(static_cast<uint32_t>(size));
+  std::memcpy(&m_data[pos], &length, prefix_size);
+  if (size != 0)
+    std::memcpy(&m_data[pos + prefix_size], msg.data(), size);
+
+  ++m_count;
+
+  return true;
+}
+
+void message_batch::clear()
+{
+  m_data.clear();
+  m_count = 0;
+}
+
+std::size_t message_records::iterator::length() const
+{
+  if (m_size - m_pos < message_batch::prefix_size)
+    throw message::deserialize_error(__func__, "record length truncated");
+
+  uint32_t length;
+  std::memcpy(&length, m_data + m_pos, sizeof(length));
+  length = utility::betoh(length);
+
+  if (m_size - m_pos - message_batch::prefix_size < length)
+    throw message::deserialize_error(__func__, "record truncated");
+
+  return length;
+}
+
+} /* namespace signum */
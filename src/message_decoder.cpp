@@ -0,0 +1,351 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "signum/message.hpp"
+#include "signum/message_decoder.hpp"
+#include "signum/utility/endian.hpp"
+
+namespace signum {
+
+namespace
+{
+using formats = message::formats;
+
+//! Returns the header bytes following a format byte, or -1 if invalid
+int header_extra(uint8_t format)
+{
+  if (format < 0xc0 || format >= 0xe0)
+    return 0; // fixint, fixmap, fixarray and fixstr
+
+  switch (static_cast<formats>(format))
+  {
+  case formats::nil:
+  case formats::boolfalse:
+  case formats::booltrue:
+    return 0;
+  case formats::uint8:
+  case formats::int8:
+  case formats::bin8:
+  case formats::str8:
+  case formats::fixext1:
+  case formats::fixext2:
+  case formats::fixext4:
+  case formats::fixext8:
+  case formats::fixext16:
+    return 1;
+  case formats::ext8:
+    return 2;
+  case formats::uint16:
+  case formats::int16:
+  case formats::bin16:
+  case formats::str16:
+  case formats::array16:
+  case formats::map16:
+    return 2;
+  case formats::ext16:
+    return 3;
+  case formats::uint32:
+  case formats::int32:
+  case formats::float32:
+  case formats::bin32:
+  case formats::str32:
+  case formats::array32:
+  case formats::map32:
+    return 4;
+  case formats::ext32:
+    return 5;
+  case formats::uint64:
+  case formats::int64:
+  case formats::float64:
+    return 8;
+  default:
+    return -1;
+  }
+}
+
+//! Load a big endian integer from a header
+template<typename T>
+T load(const uint8_t* data)
+{
+  T value;
+  std::memcpy(&value, data, sizeof(value));
+  return utility::betoh(value);
+}
+
+template<>
+uint8_t load<uint8_t>(const uint8_t* data)
+{
+  return data[0];
+}
+} /* namespace (anonymous) */
+
+message_decoder::message_decoder() :
+    m_header_size(0), m_payload(0), m_pending()
+{ }
+
+void message_decoder::reset()
+{
+  m_header_size = 0;
+  m_payload = 0;
+  m_pending.clear();
+}
+
+message_decoder::status message_decoder::next(
+    const void* data, std::size_t size, std::size_t& used, object& obj)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+  used = 0;
+
+  // The payload of a string, binary or extension is passed through in place
+  if (m_payload != 0)
+  {
+    if (size == 0)
+      return status::need_more;
+
+    const auto count = static_cast<std::size_t>(std::min<uint64_t>(m_payload, size));
+
+    obj.kind = kinds::chunk;
+    obj.data = bytes;
+    obj.size = count;
+
+    m_payload -= count;
+    used = count;
+
+    if (m_payload == 0)
+      finish();
+
+    return status::object;
+  }
+
+  if (m_header_size == 0)
+  {
+    if (size == 0)
+      return status::need_more;
+
+    if (header_extra(bytes[0]) < 0)
+      return status::error;
+
+    m_header[m_header_size++] = bytes[used++];
+  }
+
+  // A header split across fragments is gathered before it is decoded
+  const auto needed = 1 + static_cast<std::size_t>(header_extra(m_header[0]));
+  const auto count = std::min(needed - m_header_size, size - used);
+
+  std::memcpy(m_header + m_header_size, bytes + used, count);
+  m_header_size += count;
+  used += count;
+
+  if (m_header_size < needed)
+    return status::need_more;
+
+  decode_header(obj);
+  m_header_size = 0;
+
+  obj.data = nullptr;
+  obj.size = 0;
+
+  return status::object;
+}
+
+void message_decoder::decode_header(object& obj)
+{
+  const uint8_t format = m_header[0];
+  const uint8_t* extra = m_header + 1;
+
+  obj.type = 0;
+
+  if (format < 0x80)
+  {
+    obj.kind = kinds::uinteger;
+    obj.uinteger = format;
+  }
+  else if (format >= 0xe0)
+  {
+    obj.kind = kinds::sinteger;
+    obj.sinteger = static_cast<int8_t>(format);
+  }
+  else if (format < 0x90)
+  {
+    obj.kind = kinds::map;
+    obj.length = format & 0x0f;
+  }
+  else if (format < 0xa0)
+  {
+    obj.kind = kinds::array;
+    obj.length = format & 0x0f;
+  }
+  else if (format < 0xc0)
+  {
+    obj.kind = kinds::str;
+    obj.length = format & 0x1f;
+  }
+  else
+  {
+    switch (static_cast<formats>(format))
+    {
+    case formats::nil:
+      obj.kind = kinds::nil;
+      break;
+    case formats::boolfalse:
+    case formats::booltrue:
+      obj.kind = kinds::boolean;
+      obj.boolean = format == formats::booltrue;
+      break;
+    case formats::uint8:
+      obj.kind = kinds::uinteger;
+      obj.uinteger = load<uint8_t>(extra);
+      break;
+    case formats::uint16:
+      obj.kind = kinds::uinteger;
+      obj.uinteger = load<uint16_t>(extra);
+      break;
+    case formats::uint32:
+      obj.kind = kinds::uinteger;
+      obj.uinteger = load<uint32_t>(extra);
+      break;
+    case formats::uint64:
+      obj.kind = kinds::uinteger;
+      obj.uinteger = load<uint64_t>(extra);
+      break;
+    case formats::int8:
+      obj.kind = kinds::sinteger;
+      obj.sinteger = static_cast<int8_t>(load<uint8_t>(extra));
+      break;
+    case formats::int16:
+      obj.kind = kinds::sinteger;
+      obj.sinteger = static_cast<int16_t>(load<uint16_t>(extra));
+      break;
+    case formats::int32:
+      obj.kind = kinds::sinteger;
+      obj.sinteger = static_cast<int32_t>(load<uint32_t>(extra));
+      break;
+    case formats::int64:
+      obj.kind = kinds::sinteger;
+      obj.sinteger = static_cast<int64_t>(load<uint64_t>(extra));
+      break;
+    case formats::float32:
+    {
+      const uint32_t bits = load<uint32_t>(extra);
+      float value;
+      std::memcpy(&value, &bits, sizeof(value));
+      obj.kind = kinds::floating;
+      obj.floating = value;
+      break;
+    }
+    case formats::float64:
+    {
+      const uint64_t bits = load<uint64_t>(extra);
+      double value;
+      std::memcpy(&value, &bits, sizeof(value));
+      obj.kind = kinds::floating;
+      obj.floating = value;
+      break;
+    }
+    case formats::str8:
+      obj.kind = kinds::str;
+      obj.length = load<uint8_t>(extra);
+      break;
+    case formats::str16:
+      obj.kind = kinds::str;
+      obj.length = load<uint16_t>(extra);
+      break;
+    case formats::str32:
+      obj.kind = kinds::str;
+      obj.length = load<uint32_t>(extra);
+      break;
+    case formats::bin8:
+      obj.kind = kinds::bin;
+      obj.length = load<uint8_t>(extra);
+      break;
+    case formats::bin16:
+      obj.kind = kinds::bin;
+      obj.length = load<uint16_t>(extra);
+      break;
+    case formats::bin32:
+      obj.kind = kinds::bin;
+      obj.length = load<uint32_t>(extra);
+      break;
+    case formats::fixext1:
+    case formats::fixext2:
+    case formats::fixext4:
+    case formats::fixext8:
+    case formats::fixext16:
+      obj.kind = kinds::ext;
+      obj.length = 1u << (format - static_cast<uint8_t>(formats::fixext1));
+      obj.type = static_cast<int8_t>(extra[0]);
+      break;
+    case formats::ext8:
+      obj.kind = kinds::ext;
+      obj.length = load<uint8_t>(extra);
+      obj.type = static_cast<int8_t>(extra[1]);
+      break;
+    case formats::ext16:
+      obj.kind = kinds::ext;
+      obj.length = load<uint16_t>(extra);
+      obj.type = static_cast<int8_t>(extra[2]);
+      break;
+    case formats::ext32:
+      obj.kind = kinds::ext;
+      obj.length = load<uint32_t>(extra);
+      obj.type = static_cast<int8_t>(extra[4]);
+      break;
+    case formats::array16:
+      obj.kind = kinds::array;
+      obj.length = load<uint16_t>(extra);
+      break;
+    case formats::array32:
+      obj.kind = kinds::array;
+      obj.length = load<uint32_t>(extra);
+      break;
+    case formats::map16:
+      obj.kind = kinds::map;
+      obj.length = load<uint16_t>(extra);
+      break;
+    default: // map32, since the format was checked when it arrived
+      obj.kind = kinds::map;
+      obj.length = load<uint32_t>(extra);
+      break;
+    }
+  }
+
+  switch (obj.kind)
+  {
+  case kinds::str:
+  case kinds::bin:
+  case kinds::ext:
+    m_payload = obj.length;
+    if (m_payload == 0)
+      finish();
+    break;
+  case kinds::array:
+    if (obj.length == 0)
+      finish();
+    else
+      m_pending.push_back(obj.length);
+    break;
+  case kinds::map:
+    if (obj.length == 0)
+      finish();
+    else
+      m_pending.push_back(2 * obj.length);
+    break;
+  default:
+    finish();
+    break;
+  }
+}
+
+void message_decoder::finish()
+{
+  // A container is complete with its last element, which may complete its own
+  while (!m_pending.empty() && --m_pending.back() == 0)
+    m_pending.pop_back();
+}
+
+} /* namespace signum */
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "signum/message_pool.hpp"
+
+namespace signum {
+
+//! The state shared by a pool, its messages and the caches of its threads
+struct message_pool::state
+{
+  explicit state(std::size_t reserve) : reserve(reserve) { }
+
+  ~state()
+  {
+    for (auto msg : messages)
+      delete msg;
+  }
+
+  const std::size_t reserve;      //!< bytes reserved by each message
+  std::mutex mutex;               //!< protects the free messages
+  std::vector<message*> messages; //!< free messages not cached by a thread
+};
+
+//! The free messages a thread keeps from each pool it uses
+class message_pool::thread_cache
+{
+public:
+  struct entry
+  {
+    std::weak_ptr<state> pool; //!< expires once the pool and its messages are gone
+    std::vector<message*> messages;
+  };
+
+  ~thread_cache()
+  {
+    // Messages cached by an exiting thread are left to the other threads
+    for (auto& e : m_entries)
+    {
+      if (auto pool = e.pool.lock())
+      {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->messages.insert(pool->messages.end(),
+                              e.messages.begin(), e.messages.end());
+      }
+      else
+      {
+        release(e);
+      }
+    }
+  }
+
+  /*!
+   * Returns the cache of a pool, which is made on first use by a thread.
+   * The caches of pools that have since been destroyed are released, so a
+   * long lived thread only keeps those of pools that still exist.
+   */
+  entry& find(const std::shared_ptr<state>& pool)
+  {
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                   [](entry& e) { return release(e); }),
+                    m_entries.end());
+
+    // Compare the owners, which needs no reference count update
+    for (auto& e : m_entries)
+      if (!e.pool.owner_before(pool) && !pool.owner_before(e.pool))
+        return e;
+
+    m_entries.push_back(entry{pool, {}});
+    m_entries.back().messages.reserve(cache_size);
+
+    return m_entries.back();
+  }
+
+private:
+  //! Free the messages cached from a pool if it was destroyed
+  static bool release(entry& e)
+  {
+    if (!e.pool.expired())
+      return false;
+
+    for (auto msg : e.messages)
+      delete msg;
+    e.messages.clear();
+
+    return true;
+  }
+
+  std::vector<entry> m_entries;
+};
+
+constexpr std::size_t message_pool::cache_size;
+constexpr std::size_t message_pool::max_growth;
+
+message_pool::thread_cache& message_pool::local_cache()
+{
+  thread_local thread_cache cache;
+  return cache;
+}
+
+message_pool::message_pool(std::size_t reserve, std::size_t count) :
+    m_state(std::make_shared<state>(reserve))
+{
+  m_state->messages.reserve(count);
+
+  for (std::size_t n = 0; n < count; ++n)
+  {
+    std::unique_ptr<message> msg(new message);
+    msg->reserve(reserve);
+    m_state->messages.push_back(msg.release());
+  }
+}
+
+std::size_t message_pool::reserve() const
+{
+  return m_state->reserve;
+}
+
+message_pool::pointer message_pool::acquire()
+{
+  auto& local = local_cache().find(m_state);
+
+  // Refill half the cache at once so the lock is rarely taken
+  if (local.messages.empty())
+  {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+
+    auto& shared = m_state->messages;
+    const auto count = std::min(shared.size(), cache_size / 2);
+
+    local.messages.insert(local.messages.end(), shared.end() - count, shared.end());
+    shared.erase(shared.end() - count, shared.end());
+  }
+
+  message* msg;
+  if (local.messages.empty())
+  {
+    std::unique_ptr<message> fresh(new message);
+    fresh->reserve(m_state->reserve);
+    msg = fresh.release();
+  }
+  else
+  {
+    msg = local.messages.back();
+    local.messages.pop_back();
+  }
+
+  return pointer(msg, deleter(m_state));
+}
+
+void message_pool::deleter::operator()(message* msg) const
+{
+  // A message that grew well past the reservation is freed rather than
+  // kept, so one large message does not pin its space in the pool
+  if (msg->capacity() > max_growth * m_pool->reserve)
+  {
+    delete msg;
+    return;
+  }
+
+  msg->clear();
+
+  auto& local = local_cache().find(m_pool);
+
+  if (local.messages.size() < cache_size)
+  {
+    local.messages.push_back(msg);
+    return;
+  }
+
+  // Return half the cache at once so the lock is rarely taken
+  std::lock_guard<std::mutex> lock(m_pool->mutex);
+
+  auto& shared = m_pool->messages;
+  const auto first = local.messages.end() - cache_size / 2;
+
+  shared.insert(shared.end(), first, local.messages.end());
+  local.messages.erase(first, local.messages.end());
+  shared.push_back(msg);
+}
+
+} /* namespace signum */
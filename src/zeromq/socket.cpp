@@ -6,6 +6,7 @@
 
 #include "signum/zeromq/socket.hpp"
 #include "signum/message.hpp"
+#include "signum/message_batch.hpp"
 
 namespace signum
 {
@@ -53,6 +54,14 @@ socket& socket::send(const signum::message& msg)
   return *this;
 }
 
+socket& socket::send(const signum::message_batch& batch)
+{
+  if (zmq_send(m_socket, batch.data(), batch.size(), 0) == -1)
+    throw socket_error(__func__);
+
+  return *this;
+}
+
 socket& socket::recv(signum::message& msg)
 {
   const std::size_t size = 1024;
@@ -74,6 +83,35 @@ socket& socket::recv(signum::message& msg)
   return *this;
 }
 
+socket& socket::recv(const std::function<void(signum::message_view&)>& handler)
+{
+  zmq_msg_t frame;
+  zmq_msg_init(&frame);
+
+  if (zmq_msg_recv(&frame, m_socket, 0) == -1)
+  {
+    socket_error error(__func__);
+    zmq_msg_close(&frame);
+    throw error;
+  }
+
+  // The frame is deserialized in place and released afterwards
+  try
+  {
+    signum::message_view view(zmq_msg_data(&frame), zmq_msg_size(&frame));
+    handler(view);
+  }
+  catch (...)
+  {
+    zmq_msg_close(&frame);
+    throw;
+  }
+
+  zmq_msg_close(&frame);
+
+  return *this;
+}
+
 socket::socket_error::socket_error(
     const std::string& where, const std::string& what)
         : std::runtime_error(where + ": " + what)
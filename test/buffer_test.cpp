@@ -46,3 +46,16 @@ BOOST_AUTO_TEST_CASE(buffer_array_test)
   BOOST_CHECK_EQUAL_COLLECTIONS(arr.begin(), arr.end(), buf.begin(), buf.end());
 }
 
+
+BOOST_AUTO_TEST_CASE(buffer_pointer_test)
+{
+  std::array<int, 10> arr;
+
+  signum::buffer<int> buf(arr.data() + 2, 5);
+
+  std::iota(arr.begin(), arr.end(), -1);
+
+  BOOST_CHECK_EQUAL(buf.size(), 5);
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(arr.begin() + 2, arr.begin() + 7, buf.begin(), buf.end());
+}
@@ -6,8 +6,24 @@
 #include <boost/test/unit_test.hpp>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <complex>
 #include <functional>
+#include <numeric>
 #include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "signum/circular_buffer.hpp"
 
@@ -72,3 +88,735 @@ BOOST_AUTO_TEST_CASE(buffer_test)
   BOOST_CHECK_EQUAL_COLLECTIONS(
       ref.begin(), ref.end(), rd.begin(), rd.end());
 }
+
+BOOST_AUTO_TEST_CASE(threaded_buffer_test)
+{
+  const size_t count = 1 << 20;
+  const size_t block = 1000;
+  auto wr = cb::writer<uint32_t>(4095);
+  auto rd = wr.make_reader();
+
+  std::thread producer([&]{
+    uint32_t value = 0;
+    for (size_t n = 0; n < count; n += block)
+    {
+      const auto sz = std::min(block, count - n);
+      wr.wait(sz);
+      std::iota(wr.begin(), wr.begin() + sz, value);
+      value += sz;
+      wr.consume(sz);
+    }
+  });
+
+  // Consume in a different block size so the indices interleave
+  uint32_t expected = 0;
+  bool ordered = true;
+  while (expected < count)
+  {
+    rd.wait(1);
+    const auto sz = std::min<size_t>(rd.size(), 777);
+    for (auto it = rd.begin(); it != rd.begin() + sz; ++it)
+      ordered = ordered && (*it == expected++);
+    rd.consume(sz);
+  }
+
+  producer.join();
+
+  BOOST_CHECK(ordered);
+  BOOST_CHECK_EQUAL(expected, count);
+  BOOST_CHECK(rd.empty());
+}
+
+BOOST_AUTO_TEST_CASE(broadcast_buffer_test)
+{
+  auto wr = cb::writer<int>(1023);
+  auto first = wr.make_reader();
+
+  std::iota(wr.begin(), wr.begin() + 10, 0);
+  wr.consume(10);
+
+  // Later readers only see items written after they are made
+  auto second = wr.make_reader();
+  BOOST_REQUIRE_EQUAL(first.size(), 10);
+  BOOST_REQUIRE_EQUAL(second.size(), 0);
+  BOOST_REQUIRE(first == second);
+
+  std::iota(wr.begin(), wr.begin() + 20, 10);
+  wr.consume(20);
+
+  BOOST_REQUIRE_EQUAL(first.size(), 30);
+  BOOST_REQUIRE_EQUAL(second.size(), 20);
+  BOOST_CHECK_EQUAL(*first.begin(), 0);
+  BOOST_CHECK_EQUAL(*second.begin(), 10);
+
+  // The writer is limited by the slowest reader
+  second.consume(20);
+  BOOST_CHECK_EQUAL(wr.size(), wr.max_size() - 30);
+  first.consume(25);
+  BOOST_CHECK_EQUAL(wr.size(), wr.max_size() - 5);
+
+  // A moved reader keeps its index
+  auto third = std::move(first);
+  BOOST_CHECK_EQUAL(third.size(), 5);
+  BOOST_CHECK_EQUAL(*third.begin(), 25);
+
+  // A destroyed reader no longer limits the writer
+  {
+    auto slow = wr.make_reader();
+    wr.consume(wr.size());
+    BOOST_CHECK_EQUAL(wr.size(), 0);
+    third.clear();
+    second.clear();
+    BOOST_CHECK_EQUAL(wr.size(), 5);
+  }
+  BOOST_CHECK_EQUAL(wr.size(), wr.max_size());
+}
+
+BOOST_AUTO_TEST_CASE(huge_page_buffer_test)
+{
+  const size_t huge = 1 << 21;
+
+  // Huge pages are optional so the buffer must work either way
+  cb::options opts;
+  opts.pages = cb::page_sizes::huge_2mb;
+  auto wr = cb::writer<std::complex<float>>(1000, opts);
+  auto rd = wr.make_reader();
+
+  const auto bytes = (wr.max_size() + 1) * sizeof(std::complex<float>);
+  BOOST_REQUIRE_GE(wr.max_size(), 1000);
+  if (bytes % huge != 0)
+    BOOST_TEST_MESSAGE("huge pages unavailable, fell back to system pages");
+
+  std::fill_n(wr.begin(), wr.size(), std::complex<float>(1, -1));
+  wr.consume(wr.size());
+  BOOST_REQUIRE_EQUAL(rd.size(), wr.max_size());
+  BOOST_CHECK(std::all_of(rd.begin(), rd.end(),
+      [](std::complex<float> x) { return x == std::complex<float>(1, -1); }));
+}
+
+BOOST_AUTO_TEST_CASE(named_buffer_test)
+{
+  const auto name = "/signum_test_" + std::to_string(getpid());
+  const uint32_t count = 1 << 18;
+
+  auto wr = cb::writer<uint32_t>(name, 1023);
+
+  pid_t pid = fork();
+  BOOST_REQUIRE_NE(pid, -1);
+
+  if (pid == 0)
+  {
+    // Read the sequence in another process and report through the exit code
+    int status = 0;
+    try
+    {
+      auto rd = cb::reader<uint32_t>(name);
+      uint32_t expected = 0;
+      while (expected < count)
+      {
+        rd.wait(1);
+        for (auto it = rd.begin(); it != rd.end(); ++it)
+          status |= (*it != expected++);
+        rd.consume(rd.size());
+      }
+    }
+    catch (...)
+    {
+      status = 2;
+    }
+    _exit(status);
+  }
+
+  uint32_t value = 0;
+  while (value < count)
+  {
+    wr.wait(1);
+    const auto sz = std::min<size_t>(wr.size(), count - value);
+    std::iota(wr.begin(), wr.begin() + sz, value);
+    value += sz;
+    wr.consume(sz);
+  }
+
+  int status;
+  BOOST_REQUIRE_EQUAL(waitpid(pid, &status, 0), pid);
+  BOOST_REQUIRE(WIFEXITED(status));
+  BOOST_CHECK_EQUAL(WEXITSTATUS(status), 0);
+
+  // Opening with an item size that does not divide or multiply that of the
+  // writer fails, while a compatible one reinterprets the items
+  BOOST_CHECK_THROW((cb::reader<std::array<char,3>>{name}), std::runtime_error);
+  BOOST_CHECK_NO_THROW(cb::reader<uint16_t>{name});
+
+  // State kept by the writer in its process is not available to an opened
+  // reader, which would otherwise never be signalled or see a tag
+  auto opened = cb::reader<uint32_t>(name);
+  BOOST_CHECK_THROW(opened.event_fd(), std::logic_error);
+  BOOST_CHECK_THROW(opened.tags(), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(attach_while_writing_test)
+{
+  using namespace std::chrono;
+
+  const size_t block = 100;
+  auto wr = cb::writer<uint32_t>(1023);
+  auto first = wr.make_reader();
+  std::atomic<bool> stop(false);
+
+  std::thread producer([&]{
+    uint32_t value = 0;
+    while (!stop)
+    {
+      const auto sz = wr.wait_for(block, milliseconds(1));
+      std::iota(wr.begin(), wr.begin() + sz, value);
+      value += sz;
+      wr.consume(sz);
+    }
+  });
+
+  std::thread consumer([&]{
+    while (!stop)
+      first.consume(first.wait_for(block, milliseconds(1)));
+  });
+
+  // A reader attached while the writer runs never sees a torn first view
+  bool ordered = true;
+  for (int n = 0; n < 1000; ++n)
+  {
+    auto rd = wr.make_reader();
+    rd.wait(block);
+    const auto sz = rd.size();
+    BOOST_REQUIRE(sz <= rd.max_size());
+    for (auto it = rd.begin() + 1; it != rd.begin() + sz; ++it)
+      ordered = ordered && (*it == *(it - 1) + 1);
+  }
+
+  stop = true;
+  producer.join();
+  consumer.join();
+
+  BOOST_CHECK(ordered);
+}
+
+BOOST_AUTO_TEST_CASE(timed_wait_test)
+{
+  using namespace std::chrono;
+
+  auto wr = cb::writer<int>(1023);
+  auto rd = wr.make_reader();
+
+  // An expired wait returns the partial count
+  wr.consume(3);
+  BOOST_CHECK_EQUAL(rd.wait_for(10, milliseconds(0)), 3);
+
+  const auto start = steady_clock::now();
+  BOOST_CHECK_EQUAL(rd.wait_for(10, milliseconds(20)), 3);
+  BOOST_CHECK(steady_clock::now() - start >= milliseconds(20));
+
+  BOOST_CHECK_EQUAL(rd.wait_until(10, system_clock::now() + milliseconds(1)), 3);
+
+  // A satisfied wait returns as soon as the items arrive
+  std::thread producer([&]{
+    std::this_thread::sleep_for(milliseconds(10));
+    wr.consume(7);
+  });
+  BOOST_CHECK_EQUAL(rd.wait_for(10, seconds(10)), 10);
+  producer.join();
+
+  // A timeout past the end of the clock waits without a deadline
+  std::thread late([&]{
+    std::this_thread::sleep_for(milliseconds(10));
+    wr.consume(5);
+  });
+  BOOST_CHECK_EQUAL(rd.wait_for(15, nanoseconds::max()), 15);
+  late.join();
+  BOOST_CHECK_EQUAL(rd.wait_for(15, hours::max()), 15);
+  BOOST_CHECK_EQUAL(rd.wait_for(20, hours::min()), 15);
+  BOOST_CHECK_EQUAL(rd.wait_until(15, system_clock::time_point::max() - hours(1)), 15);
+
+  // The writer waits for space in the same way
+  BOOST_CHECK_EQUAL(wr.wait_for(wr.max_size(), milliseconds(1)), wr.max_size() - 15);
+  rd.clear();
+  BOOST_CHECK_EQUAL(wr.wait_for(wr.max_size(), milliseconds(1)), wr.max_size());
+}
+
+BOOST_AUTO_TEST_CASE(wait_policy_test)
+{
+  for (auto mode : { cb::wait_modes::block, cb::wait_modes::spin, cb::wait_modes::poll })
+  {
+    cb::options opts;
+    opts.wait.mode = mode;
+    opts.wait.spins = 100;
+
+    auto wr = cb::writer<uint32_t>(511, opts);
+    auto rd = wr.make_reader();
+    BOOST_CHECK(rd.get_wait_policy().mode == mode);
+
+    const uint32_t count = 1 << 16;
+    std::thread producer([&]{
+      for (uint32_t value = 0; value < count; ++value)
+      {
+        wr.wait(1);
+        *wr.begin() = value;
+        wr.consume(1);
+      }
+    });
+
+    uint32_t expected = 0;
+    bool ordered = true;
+    while (expected < count)
+    {
+      rd.wait(1);
+      ordered = ordered && (*rd.begin() == expected++);
+      rd.consume(1);
+    }
+    producer.join();
+
+    BOOST_CHECK(ordered);
+
+    // Polling honours a deadline without sleeping
+    rd.set_wait_policy({cb::wait_modes::poll, 0});
+    BOOST_CHECK_EQUAL(rd.wait_for(1, std::chrono::milliseconds(1)), 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(drop_oldest_test)
+{
+  cb::options opts;
+  opts.overrun = cb::overrun_modes::drop_oldest;
+
+  auto wr = cb::writer<int>(1023, opts);
+  auto rd = wr.make_reader();
+  const auto max = static_cast<int>(wr.max_size());
+
+  std::iota(wr.begin(), wr.end(), 0);
+  wr.consume(wr.size());
+  BOOST_REQUIRE_EQUAL(wr.size(), 0);
+
+  // The writer makes room by advancing the reader instead of blocking
+  wr.wait(10);
+  BOOST_REQUIRE_EQUAL(wr.size(), 10);
+  BOOST_CHECK_EQUAL(rd.overruns(), 10);
+  BOOST_CHECK_EQUAL(wr.overruns(), 10);
+  BOOST_REQUIRE_EQUAL(rd.size(), wr.max_size() - 10);
+  BOOST_CHECK_EQUAL(*rd.begin(), 10);
+
+  std::iota(wr.begin(), wr.end(), max);
+  wr.consume(10);
+
+  // A reader consuming items that were already dropped does not move back
+  rd.consume(5);
+  wr.wait(20);
+  BOOST_CHECK_EQUAL(rd.overruns(), 25);
+  rd.consume(1);
+  BOOST_CHECK_EQUAL(*rd.begin(), 31);
+  BOOST_CHECK_EQUAL(rd.end()[-1], max + 9);
+}
+
+BOOST_AUTO_TEST_CASE(drop_newest_test)
+{
+  cb::options opts;
+  opts.overrun = cb::overrun_modes::drop_newest;
+
+  auto wr = cb::writer<int>(1023, opts);
+  auto rd = wr.make_reader();
+
+  std::iota(wr.begin(), wr.end(), 0);
+  wr.consume(wr.size() + 100);
+  BOOST_CHECK_EQUAL(wr.overruns(), 100);
+  BOOST_CHECK_EQUAL(rd.overruns(), 0);
+
+  // The writer never blocks and the reader keeps the oldest items
+  BOOST_CHECK_EQUAL(wr.wait_for(1, std::chrono::seconds(10)), 0);
+  BOOST_REQUIRE_EQUAL(rd.size(), wr.max_size());
+  BOOST_CHECK_EQUAL(*rd.begin(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(event_fd_test)
+{
+  auto wr = cb::writer<int>(1023);
+  auto rd = wr.make_reader();
+
+  auto readable = [](int fd, int timeout) {
+    pollfd pfd = { fd, POLLIN, 0 };
+    return poll(&pfd, 1, timeout) == 1 && (pfd.revents & POLLIN);
+  };
+
+  const int fd = rd.event_fd(10);
+  BOOST_REQUIRE(fd >= 0);
+  BOOST_CHECK(!readable(fd, 0));
+
+  // The descriptor becomes readable only once the threshold is reached
+  wr.consume(5);
+  BOOST_CHECK(!readable(fd, 0));
+  wr.consume(5);
+  BOOST_CHECK(readable(fd, 0));
+
+  // It stays readable until the reader falls below the threshold
+  wr.consume(5);
+  rd.consume(5);
+  BOOST_CHECK(readable(fd, 0));
+  rd.consume(1);
+  BOOST_CHECK(!readable(fd, 0));
+
+  // Changing the threshold keeps the descriptor and rechecks the buffer
+  BOOST_CHECK_EQUAL(rd.event_fd(5), fd);
+  BOOST_CHECK(readable(fd, 0));
+  rd.consume(rd.size());
+  BOOST_CHECK(!readable(fd, 0));
+
+  BOOST_CHECK_THROW(rd.event_fd(0), std::invalid_argument);
+  BOOST_CHECK_THROW(rd.event_fd(wr.max_size() + 1), std::invalid_argument);
+
+  // A writer on another thread wakes a poll loop
+  rd.event_fd(100);
+  std::thread producer([&]{
+    for (int n = 0; n < 100; ++n)
+    {
+      wr.wait(1);
+      wr.consume(1);
+    }
+  });
+  BOOST_CHECK(readable(fd, 10000));
+  producer.join();
+  BOOST_CHECK_EQUAL(rd.size(), 100);
+}
+
+BOOST_AUTO_TEST_CASE(tag_test)
+{
+  auto wr = cb::writer<int>(1023);
+  auto rd = wr.make_reader();
+
+  BOOST_CHECK(rd.tags().empty());
+
+  // Tags are added in any order and only seen once their items are produced
+  wr.add_tag(20, "burst", {0});
+  wr.add_tag(0, "time", {1, 2, 3, 4});
+  wr.add_tag(10, "freq");
+  BOOST_CHECK_THROW(wr.add_tag(wr.size(), "late"), std::out_of_range);
+  BOOST_CHECK(rd.tags().empty());
+
+  wr.consume(15);
+  auto tags = rd.tags();
+  BOOST_REQUIRE_EQUAL(tags.size(), 2);
+  BOOST_CHECK_EQUAL(tags[0].offset, 0);
+  BOOST_CHECK_EQUAL(tags[0].key, "time");
+  BOOST_CHECK_EQUAL(tags[0].value.size(), 4);
+  BOOST_CHECK_EQUAL(tags[1].offset, 10);
+  BOOST_CHECK_EQUAL(tags[1].key, "freq");
+
+  // Tags are keyed by absolute index, so they follow the reader
+  rd.consume(11);
+  BOOST_CHECK_EQUAL(rd.index(), 11);
+  BOOST_CHECK(rd.tags().empty());
+
+  wr.consume(10);
+  tags = rd.tags();
+  BOOST_REQUIRE_EQUAL(tags.size(), 1);
+  BOOST_CHECK_EQUAL(tags[0].offset - rd.index(), 9);
+  BOOST_CHECK_EQUAL(tags[0].key, "burst");
+
+  // Each reader sees the tags of its own window across wrap around
+  wr.consume(500);
+  rd.clear();
+  auto rd2 = wr.make_reader();
+  for (int n = 0; n < 3; ++n)
+  {
+    wr.add_tag(299, "end");
+    wr.consume(300);
+    rd.clear();
+  }
+  tags = rd2.tags();
+  BOOST_REQUIRE_EQUAL(tags.size(), 3);
+  for (const auto & t : tags)
+    BOOST_CHECK_EQUAL(t.key, "end");
+  BOOST_CHECK(rd.tags().empty());
+
+  // A faster reader reading tags never discards those a slower one has not
+  rd2.clear();
+  wr.add_tag(5, "slow");
+  wr.consume(10);
+  rd.clear();
+  BOOST_CHECK(rd.tags().empty());
+  tags = rd2.tags();
+  BOOST_REQUIRE_EQUAL(tags.size(), 1);
+  BOOST_CHECK_EQUAL(tags[0].key, "slow");
+}
+
+BOOST_AUTO_TEST_CASE(fd_transfer_test)
+{
+  auto wr = cb::writer<uint32_t>(1023);
+  auto rd = wr.make_reader();
+
+  int in[2], out[2];
+  BOOST_REQUIRE_EQUAL(pipe2(in, O_NONBLOCK), 0);
+  BOOST_REQUIRE_EQUAL(pipe2(out, O_NONBLOCK), 0);
+
+  std::vector<uint32_t> source(100);
+  std::iota(source.begin(), source.end(), 0);
+  const auto bytes = reinterpret_cast<const char *>(source.data());
+
+  // Nothing to read yet
+  BOOST_CHECK_EQUAL(wr.fill_from(in[0]), -1);
+
+  // A partial item is held back until the rest of it arrives
+  BOOST_REQUIRE_EQUAL(write(in[1], bytes, 6), 6);
+  BOOST_CHECK_EQUAL(wr.fill_from(in[0]), 6);
+  BOOST_CHECK_EQUAL(rd.size(), 1);
+  BOOST_REQUIRE_EQUAL(write(in[1], bytes + 6, 394), 394);
+  BOOST_CHECK_EQUAL(wr.fill_from(in[0]), 394);
+  BOOST_REQUIRE_EQUAL(rd.size(), 100);
+  BOOST_CHECK(std::equal(source.begin(), source.end(), rd.begin()));
+
+  // Items are written straight from the buffer and consumed
+  BOOST_CHECK_EQUAL(rd.drain_to(out[1]), 400);
+  BOOST_CHECK(rd.empty());
+  BOOST_CHECK_EQUAL(rd.drain_to(out[1]), -1);
+
+  std::vector<uint32_t> sink(100);
+  BOOST_REQUIRE_EQUAL(read(out[0], sink.data(), 400), 400);
+  BOOST_CHECK(sink == source);
+
+  // The end of the file is reported as zero bytes, with any incomplete item
+  BOOST_REQUIRE_EQUAL(write(in[1], bytes, 2), 2);
+  close(in[1]);
+  BOOST_CHECK_EQUAL(wr.fill_from(in[0]), 2);
+  BOOST_CHECK_EQUAL(wr.fill_from(in[0]), 0);
+  BOOST_CHECK_EQUAL(wr.partial(), 2);
+
+  close(in[0]);
+  close(out[0]);
+  close(out[1]);
+  BOOST_CHECK_THROW(wr.fill_from(in[0]), std::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(fd_transfer_overrun_test)
+{
+  cb::options opts;
+  opts.overrun = cb::overrun_modes::drop_oldest;
+  auto wr = cb::writer<uint32_t>(4095, opts);
+  auto rd = wr.make_reader();
+
+  int in[2], out[2];
+  BOOST_REQUIRE_EQUAL(pipe2(in, O_NONBLOCK), 0);
+  BOOST_REQUIRE_EQUAL(pipe2(out, O_NONBLOCK), 0);
+
+  std::vector<uint32_t> source(wr.max_size());
+  std::iota(source.begin(), source.end(), 0);
+  const auto bytes = reinterpret_cast<const char *>(source.data());
+
+  // A full buffer drops the oldest items rather than refusing to read
+  wr.consume(wr.max_size());
+  BOOST_REQUIRE_EQUAL(write(in[1], bytes, 400), 400);
+  BOOST_CHECK_EQUAL(wr.fill_from(in[0]), 400);
+  BOOST_CHECK(rd.overruns() > 0);
+  rd.clear();
+
+  // A partially drained item is abandoned once the reader is moved. The
+  // pipe takes a page at a time, which does not hold whole items.
+  using item = std::array<uint32_t,3>;
+  auto items_wr = cb::writer<item>(1023);
+  auto items_rd = items_wr.make_reader();
+  for (uint32_t n = 0; n < items_wr.max_size(); ++n)
+    items_wr.begin()[n] = item{{n, n, n}};
+  items_wr.consume(items_wr.max_size());
+
+  BOOST_REQUIRE(fcntl(out[1], F_SETPIPE_SZ, 4096) != -1);
+  BOOST_REQUIRE_EQUAL(items_rd.drain_to(out[1]), 4096);
+  const uint32_t moved = items_rd.index() + 1;
+  items_rd.consume(1);
+
+  std::vector<char> sink(4096);
+  BOOST_REQUIRE_EQUAL(read(out[0], sink.data(), sink.size()), 4096);
+  BOOST_REQUIRE(items_rd.drain_to(out[1]) > 0);
+  item next = {{0, 0, 0}};
+  BOOST_REQUIRE_EQUAL(read(out[0], next.data(), sizeof(next)), sizeof(next));
+  BOOST_CHECK(next == (item{{moved, moved, moved}}));
+
+  close(in[0]);
+  close(in[1]);
+  close(out[0]);
+  close(out[1]);
+}
+
+BOOST_AUTO_TEST_CASE(statistics_test)
+{
+  cb::options opts;
+  opts.overrun = cb::overrun_modes::drop_newest;
+
+  auto wr = cb::writer<int>(1023, opts);
+  auto rd = wr.make_reader();
+
+  wr.consume(100);
+  rd.consume(40);
+  wr.consume(wr.size() + 5);
+
+  auto ws = wr.stats();
+  BOOST_CHECK_EQUAL(ws.items, wr.max_size() + 40);
+  BOOST_CHECK_EQUAL(ws.overruns, 5);
+
+  // A reader counts the items consumed since it was made
+  auto rd2 = wr.make_reader();
+  rd.consume(10);
+  BOOST_CHECK_EQUAL(rd.stats().items, 50);
+  BOOST_CHECK_EQUAL(rd2.stats().items, 0);
+
+  // Items dropped from under a reader are overruns, not items read
+  cb::options oldest;
+  oldest.overrun = cb::overrun_modes::drop_oldest;
+  auto wr2 = cb::writer<int>(1023, oldest);
+  auto rd3 = wr2.make_reader();
+  wr2.consume(10);
+  rd3.consume(4);
+  wr2.consume(wr2.size());
+  wr2.wait(20);
+  wr2.consume(20);
+  auto rs = rd3.stats();
+  BOOST_CHECK_GT(rs.overruns, 0);
+  BOOST_CHECK_EQUAL(rs.items, 4);
+  rd3.consume(3);
+  BOOST_CHECK_EQUAL(rd3.stats().items, 7);
+  BOOST_CHECK_EQUAL(rd3.stats().overruns, rs.overruns);
+
+#ifdef SIGNUM_CIRCULAR_BUFFER_STATS
+  BOOST_CHECK_EQUAL(ws.high_water, wr.max_size());
+
+  std::thread producer([&]{
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    wr.consume(1);
+  });
+  rd2.wait(1);
+  producer.join();
+  BOOST_CHECK(rd2.stats().blocked >= std::chrono::milliseconds(10));
+  BOOST_CHECK(rd.stats().blocked == std::chrono::nanoseconds::zero());
+#else
+  BOOST_CHECK_EQUAL(ws.high_water, 0);
+  BOOST_CHECK(ws.blocked == std::chrono::nanoseconds::zero());
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(locked_buffer_test)
+{
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t items = 4 * page_size / sizeof(int) - 1;
+
+  // Both halves of the mirror are charged against the limit
+  const size_t bytes = 2 * (items + 1) * sizeof(int);
+  rlimit limit;
+  BOOST_REQUIRE_EQUAL(getrlimit(RLIMIT_MEMLOCK, &limit), 0);
+  if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < bytes)
+  {
+    BOOST_TEST_MESSAGE("RLIMIT_MEMLOCK too small, skipped locking");
+    return;
+  }
+
+  cb::options opts;
+  opts.lock = true;
+  auto wr = cb::writer<int>(items, opts);
+  auto rd = wr.make_reader();
+
+  // Both halves of the mirror are resident before anything is written
+  std::vector<unsigned char> residency(bytes / page_size);
+  BOOST_REQUIRE_EQUAL(mincore(wr.begin(), bytes, residency.data()), 0);
+  BOOST_CHECK(std::all_of(residency.begin(), residency.end(),
+                          [](unsigned char c) { return c & 1; }));
+
+  // The mapping still behaves as a buffer
+  std::iota(wr.begin(), wr.begin() + 10, 0);
+  wr.consume(10);
+  BOOST_CHECK_EQUAL(rd.size(), 10);
+  BOOST_CHECK_EQUAL(*rd.begin(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(numa_buffer_test)
+{
+  // Every system has a node zero, which may still not permit binding
+  cb::options opts;
+  opts.node = 0;
+
+  auto wr = cb::writer<int>(1023);
+  try
+  {
+    wr = cb::writer<int>(1023, opts);
+  }
+  catch (const std::system_error & error)
+  {
+    BOOST_TEST_MESSAGE("NUMA binding unsupported: " << error.what());
+    return;
+  }
+  auto rd = wr.make_reader();
+
+  std::iota(wr.begin(), wr.end(), 0);
+  wr.consume(wr.size());
+
+  rd.bind_local();
+  BOOST_REQUIRE_EQUAL(rd.size(), wr.max_size());
+  BOOST_CHECK_EQUAL(rd.end()[-1], 1022);
+
+  opts.node = 4096;
+  BOOST_CHECK_THROW(cb::writer<int>(1023, opts), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(reinterpret_buffer_test)
+{
+  auto wr = cb::writer<uint8_t>(4095);
+  auto rd = wr.make_reader<std::complex<int16_t>>();
+  auto bytes = wr.make_reader();
+
+  // Bytes become samples without a copy, and only whole samples are seen
+  const std::complex<int16_t> samples[] = { {1, -1}, {2, -2}, {3, -3} };
+  const auto data = reinterpret_cast<const uint8_t *>(samples);
+  std::copy(data, data + 10, wr.begin());
+  wr.consume(10);
+
+  BOOST_REQUIRE_EQUAL(rd.size(), 2);
+  BOOST_CHECK_EQUAL(bytes.size(), 10);
+  BOOST_CHECK(rd.begin()[1] == samples[1]);
+  BOOST_CHECK_EQUAL(rd.max_size(), (wr.max_size() + 1) / 4 - 1);
+
+  std::copy(data + 10, data + 12, wr.begin());
+  wr.consume(2);
+  BOOST_REQUIRE_EQUAL(rd.size(), 3);
+  BOOST_CHECK(rd.begin()[2] == samples[2]);
+
+  // The writer is limited by the slowest reader in bytes
+  rd.consume(3);
+  BOOST_CHECK_EQUAL(wr.size(), wr.max_size() - 12);
+  bytes.consume(12);
+  BOOST_CHECK_EQUAL(wr.size(), wr.max_size());
+  BOOST_CHECK_EQUAL(rd.index(), 3);
+
+  // Readers can not be made where their items would be misaligned
+  wr.consume(1);
+  BOOST_CHECK_THROW(wr.make_reader<std::complex<int16_t>>(), std::invalid_argument);
+  wr.consume(1);
+  auto late = wr.make_reader<std::complex<int16_t>>();
+  BOOST_CHECK(late.empty());
+
+  // A wider writer may be read in narrower items
+  auto wide = cb::writer<uint32_t>(1023);
+  auto narrow = wide.make_reader<uint16_t>();
+  *wide.begin() = 0x00020001;
+  wide.consume(1);
+  BOOST_REQUIRE_EQUAL(narrow.size(), 2);
+  narrow.consume(1);
+  BOOST_CHECK_EQUAL(*narrow.begin(), 0x0002);
+  BOOST_CHECK_EQUAL(wide.size(), wide.max_size() - 1);
+}
+
+BOOST_AUTO_TEST_CASE(reinterpret_drop_oldest_test)
+{
+  cb::options opts;
+  opts.overrun = cb::overrun_modes::drop_oldest;
+
+  auto wr = cb::writer<uint8_t>(4095, opts);
+  auto rd = wr.make_reader<uint32_t>();
+
+  // Dropped readers stay on their own item boundaries
+  wr.consume(wr.size());
+  wr.wait(5);
+  wr.consume(5);
+  BOOST_CHECK_EQUAL(rd.overruns(), 2);
+  BOOST_CHECK_EQUAL(rd.index(), 2);
+  BOOST_CHECK_EQUAL(rd.size(), (wr.max_size() - 3) / 4);
+}
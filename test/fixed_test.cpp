@@ -36,7 +36,7 @@ void _fixed_to_float_test()
 
   BOOST_CHECK_CLOSE(lower,
                     static_cast<Float>(float_lower),
-                    static_cast<Float>(100.0*delta/float_lower));
+                    static_cast<Float>(std::abs(100.0*delta/float_lower)));
   BOOST_CHECK_CLOSE(median,
                     static_cast<Float>(float_median),
                     static_cast<Float>(100.0*delta/float_median));
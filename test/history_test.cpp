@@ -0,0 +1,101 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#define BOOST_TEST_MODULE history_test
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <future>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+#include "signum/history.hpp"
+
+namespace cb = signum::circular_buffer;
+
+namespace
+{
+//! Produce a sequence of items in blocks
+void produce(cb::writer<int> & wr, int & value, int count)
+{
+  for (int end = value + count; value < end; )
+  {
+    const auto n = std::min<int>(64, end - value);
+    wr.wait(n);
+    std::iota(wr.begin(), wr.begin() + n, value);
+    wr.consume(n);
+    value += n;
+  }
+}
+} // namespace (anonymous)
+
+BOOST_AUTO_TEST_CASE(history_test)
+{
+  const auto path = "/tmp/signum_history_" + std::to_string(getpid());
+
+  auto wr = cb::writer<int>(1023);
+  cb::history<int> hist(wr.make_reader(), 300);
+
+  // The writer is never stalled by the history beyond its window
+  int value = 0;
+  produce(wr, value, 10000);
+
+  // The window ends at the index given, however late the trigger is handled
+  auto result = hist.trigger(path, 500, wr.index());
+  produce(wr, value, 1000);
+
+  BOOST_REQUIRE_EQUAL(result.get(), 800);
+
+  // The file holds the window before the trigger followed by the rest
+  std::ifstream file(path, std::ios::binary);
+  std::vector<int> captured(800);
+  file.read(reinterpret_cast<char *>(captured.data()), captured.size() * sizeof(int));
+  BOOST_REQUIRE_EQUAL(file.gcount(), 800 * sizeof(int));
+  BOOST_CHECK_EQUAL(file.peek(), std::ifstream::traits_type::eof());
+
+  std::vector<int> expected(800);
+  std::iota(expected.begin(), expected.end(), 10000 - 300);
+  BOOST_CHECK_EQUAL_COLLECTIONS(captured.begin(), captured.end(),
+                                expected.begin(), expected.end());
+  unlink(path.c_str());
+
+  // A trigger made while a capture is in progress waits for it, and is then
+  // captured even if the writer goes quiet
+  const auto second = path + "_second";
+  auto first_result = hist.trigger(path, 500, wr.index());
+  produce(wr, value, 100);
+  const auto later = wr.index() + 1900;
+  std::future<size_t> second_result;
+  std::thread trigger([&]{
+    second_result = hist.trigger(second, 100, later);
+  });
+  produce(wr, value, 500);
+  trigger.join();
+  produce(wr, value, 1500);
+
+  BOOST_CHECK_EQUAL(first_result.get(), 800);
+  BOOST_REQUIRE_EQUAL(second_result.get(), 400);
+
+  std::ifstream second_file(second, std::ios::binary);
+  captured.resize(400);
+  second_file.read(reinterpret_cast<char *>(captured.data()), captured.size() * sizeof(int));
+  BOOST_REQUIRE_EQUAL(second_file.gcount(), 400 * sizeof(int));
+  expected.resize(400);
+  std::iota(expected.begin(), expected.end(), value - 400);
+  BOOST_CHECK_EQUAL_COLLECTIONS(captured.begin(), captured.end(),
+                                expected.begin(), expected.end());
+  unlink(path.c_str());
+  unlink(second.c_str());
+
+  // Errors are reported through the result
+  auto failed = hist.trigger("/nonexistent/signum_history", 1, wr.index());
+  BOOST_CHECK_THROW(failed.get(), std::system_error);
+
+  BOOST_CHECK_THROW(cb::history<int>(wr.make_reader(), 1000), std::invalid_argument);
+}
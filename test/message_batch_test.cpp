@@ -0,0 +1,91 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#define BOOST_TEST_MODULE message_batch_test
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "signum/message_batch.hpp"
+
+BOOST_AUTO_TEST_CASE(message_batch_test)
+{
+  signum::message_batch batch(4096, std::chrono::seconds(1));
+
+  BOOST_CHECK(batch.empty());
+  BOOST_CHECK(!batch.expired());
+
+  // Messages are framed into batches that are sent once full
+  std::vector<std::vector<uint8_t>> frames;
+  for (int32_t n = 0; n < 1000; ++n)
+  {
+    signum::message msg;
+    msg << n << "record";
+
+    if (!batch.append(msg))
+    {
+      frames.emplace_back(batch.data(), batch.data() + batch.size());
+      batch.clear();
+      BOOST_REQUIRE(batch.append(msg));
+    }
+    BOOST_REQUIRE_LE(batch.size(), 4096);
+  }
+  frames.emplace_back(batch.data(), batch.data() + batch.size());
+
+  BOOST_CHECK_GT(frames.size(), 1);
+
+  // Every record is viewed in place in the order appended
+  int32_t expected = 0;
+  bool intact = true;
+  for (const auto& frame : frames)
+  {
+    for (auto view : signum::message_records(frame.data(), frame.size()))
+    {
+      int32_t value = -1;
+      std::string str;
+      view >> value >> str;
+      intact = intact && value == expected++ && str == "record" &&
+               view.remaining() == 0 && view.data() >= frame.data();
+    }
+  }
+  BOOST_CHECK(intact);
+  BOOST_CHECK_EQUAL(expected, 1000);
+
+  // Messages that can never fit are rejected
+  signum::message large;
+  std::vector<uint8_t> bin(5000);
+  large.serialize_bin(bin.data(), bin.size());
+  BOOST_CHECK_THROW(batch.append(large), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(message_batch_age_test)
+{
+  signum::message_batch batch(1024, std::chrono::milliseconds(1));
+
+  signum::message msg;
+  msg << 1;
+  BOOST_REQUIRE(batch.append(msg));
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  BOOST_CHECK(batch.expired());
+
+  batch.clear();
+  BOOST_CHECK(!batch.expired());
+}
+
+BOOST_AUTO_TEST_CASE(message_records_truncated_test)
+{
+  const uint8_t data[] = { 0x00, 0x00, 0x00, 0x01, 0x05, 0x00, 0x00, 0x00, 0x02, 0x06 };
+
+  signum::message_records records(data, sizeof(data));
+
+  auto it = records.begin();
+  BOOST_REQUIRE(it != records.end());
+  BOOST_CHECK_EQUAL((*it).size(), 1);
+  ++it;
+  BOOST_CHECK_THROW(*it, signum::message::deserialize_error);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#define BOOST_TEST_MODULE message_decoder_test
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "signum/message_decoder.hpp"
+
+namespace
+{
+using decoder = signum::message_decoder;
+
+//! Returns { "key": [1, -2, 3.5], "bin": <300 bytes> } in MessagePack
+std::vector<uint8_t> make_message()
+{
+  std::vector<uint8_t> data = {
+    0x82, 0xa3, 'k', 'e', 'y', 0x93, 0x01, 0xfe,
+    0xcb, 0x40, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xa3, 'b', 'i', 'n', 0xc5, 0x01, 0x2c
+  };
+  data.insert(data.end(), 300, 0x5a);
+  return data;
+}
+
+//! Decode a message fed in fragments of a size, returning a summary of it
+std::string decode(const std::vector<uint8_t> & data, std::size_t fragment)
+{
+  decoder dec;
+  decoder::object obj;
+  std::string summary;
+  std::size_t payload = 0;
+
+  for (std::size_t pos = 0; pos < data.size(); pos += fragment)
+  {
+    const auto size = std::min(fragment, data.size() - pos);
+
+    // Each fragment is decoded until it is consumed
+    for (std::size_t offset = 0; ; )
+    {
+      std::size_t used;
+      const auto status = dec.next(&data[pos + offset], size - offset, used, obj);
+      offset += used;
+
+      if (status == decoder::status::need_more)
+        break;
+      BOOST_REQUIRE(status == decoder::status::object);
+
+      switch (obj.kind)
+      {
+      case decoder::kinds::map:
+        summary += "map" + std::to_string(obj.length) + " ";
+        break;
+      case decoder::kinds::array:
+        summary += "array" + std::to_string(obj.length) + " ";
+        break;
+      case decoder::kinds::str:
+        summary += "str" + std::to_string(obj.length) + " ";
+        break;
+      case decoder::kinds::bin:
+        summary += "bin" + std::to_string(obj.length) + " ";
+        break;
+      case decoder::kinds::uinteger:
+        summary += std::to_string(obj.uinteger) + " ";
+        break;
+      case decoder::kinds::sinteger:
+        summary += std::to_string(obj.sinteger) + " ";
+        break;
+      case decoder::kinds::floating:
+        summary += std::to_string(obj.floating) + " ";
+        break;
+      case decoder::kinds::chunk:
+        // Chunks point into the fragment passed in
+        BOOST_CHECK(obj.data >= &data[pos] && obj.data + obj.size <= &data[pos] + size);
+        payload += obj.size;
+        if (dec.payload() == 0)
+        {
+          summary += "<" + std::to_string(payload) + "> ";
+          payload = 0;
+        }
+        break;
+      default:
+        summary += "? ";
+        break;
+      }
+    }
+
+    BOOST_CHECK_EQUAL(dec.complete(), pos + size == data.size());
+  }
+
+  return summary;
+}
+} // namespace (anonymous)
+
+BOOST_AUTO_TEST_CASE(message_decoder_test)
+{
+  const auto data = make_message();
+  const std::string expected =
+      "map2 str3 <3> array3 1 -2 3.500000 str3 <3> bin300 <300> ";
+
+  // The same objects are decoded wherever the fragments are split
+  for (std::size_t fragment : { 1, 2, 7, 64, 1000 })
+    BOOST_CHECK_EQUAL(decode(data, fragment), expected);
+}
+
+BOOST_AUTO_TEST_CASE(message_decoder_error_test)
+{
+  const uint8_t data[] = { 0x92, 0x01, 0xc1 };
+
+  decoder dec;
+  decoder::object obj;
+  std::size_t used;
+
+  BOOST_CHECK(dec.next(data, 0, used, obj) == decoder::status::need_more);
+  BOOST_CHECK(dec.next(data, sizeof(data), used, obj) == decoder::status::object);
+  BOOST_CHECK_EQUAL(dec.depth(), 1);
+  BOOST_CHECK(dec.next(data + 1, 2, used, obj) == decoder::status::object);
+  BOOST_CHECK_EQUAL(obj.uinteger, 1);
+
+  // An invalid format is not consumed
+  BOOST_CHECK(dec.next(data + 2, 1, used, obj) == decoder::status::error);
+  BOOST_CHECK_EQUAL(used, 0);
+  BOOST_CHECK(!dec.complete());
+
+  dec.reset();
+  BOOST_CHECK(dec.complete());
+}
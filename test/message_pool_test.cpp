@@ -0,0 +1,81 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#define BOOST_TEST_MODULE message_pool_test
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "signum/message_pool.hpp"
+
+BOOST_AUTO_TEST_CASE(message_pool_test)
+{
+  signum::message_pool pool(1024, 4);
+
+  BOOST_CHECK_EQUAL(pool.reserve(), 1024);
+
+  auto msg = pool.acquire();
+  BOOST_REQUIRE(msg);
+  BOOST_CHECK_GE(msg->capacity(), 1024);
+
+  // A released message is cleared and handed out again with its space
+  std::vector<float> block(256, 1.5f);
+  msg->serialize(block.data(), block.size());
+  const auto capacity = msg->capacity();
+  const auto address = msg.get();
+  msg.reset();
+
+  msg = pool.acquire();
+  BOOST_CHECK_EQUAL(msg.get(), address);
+  BOOST_CHECK_EQUAL(msg->capacity(), capacity);
+
+  float value = 0;
+  BOOST_CHECK_THROW(*msg >> value, signum::message::deserialize_error);
+
+  // A message grown well past the reservation is freed instead of kept
+  std::vector<float> large(4096, 1.5f);
+  msg->serialize(large.data(), large.size());
+  msg.reset();
+  for (int n = 0; n < 8; ++n)
+    BOOST_CHECK_LE(pool.acquire()->capacity(),
+                   signum::message_pool::max_growth * pool.reserve());
+
+  // More messages than are pooled may be acquired
+  std::vector<signum::message_pool::pointer> messages;
+  for (int n = 0; n < 100; ++n)
+    messages.push_back(pool.acquire());
+  messages.clear();
+}
+
+BOOST_AUTO_TEST_CASE(threaded_message_pool_test)
+{
+  signum::message_pool pool(256);
+
+  // Messages acquired by one thread are released by another
+  std::vector<signum::message_pool::pointer> messages;
+  std::thread producer([&]{
+    for (int n = 0; n < 1000; ++n)
+    {
+      messages.push_back(pool.acquire());
+      *messages.back() << n;
+    }
+  });
+  producer.join();
+
+  std::thread consumer([&]{
+    for (int n = 0; n < 1000; ++n)
+    {
+      int value = -1;
+      *messages[n] >> value;
+      BOOST_CHECK_EQUAL(value, n);
+    }
+    messages.clear();
+  });
+  consumer.join();
+
+  for (int n = 0; n < 1000; ++n)
+    BOOST_CHECK(pool.acquire());
+}
@@ -5,6 +5,12 @@
 #define BOOST_TEST_MODULE signum_tests
 #include <boost/test/unit_test.hpp>
 
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
 #include "signum/message.hpp"
 
 BOOST_AUTO_TEST_CASE(message_test)
@@ -49,3 +55,208 @@ BOOST_AUTO_TEST_CASE(message_test)
 
   BOOST_CHECK_EQUAL(s32_r, s32);
 }
+
+BOOST_AUTO_TEST_CASE(message_view_test)
+{
+  // nil, true, uint8 200, int16 -300, float32 1.0 and a truncated uint32
+  const uint8_t data[] = { 0xc0, 0xc3, 0xcc, 0xc8, 0xd1, 0xfe, 0xd4,
+                           0xca, 0x3f, 0x80, 0x00, 0x00, 0xce, 0x01 };
+
+  bool b_r;
+  uint8_t u8_r;
+  int16_t s16_r;
+  float f32_r;
+  uint32_t u32_r = 0;
+
+  signum::message_view view(data, sizeof(data));
+
+  BOOST_REQUIRE_NO_THROW(view.deserialize());
+  BOOST_REQUIRE_NO_THROW(view >> b_r >> u8_r >> s16_r >> f32_r);
+  BOOST_CHECK_EQUAL(view.position(), 12);
+
+  BOOST_CHECK_EQUAL(b_r, true);
+  BOOST_CHECK_EQUAL(u8_r, 200);
+  BOOST_CHECK_EQUAL(s16_r, -300);
+  BOOST_CHECK_EQUAL(f32_r, 1.0f);
+
+  // A failed deserialization leaves the position unchanged
+  BOOST_CHECK_THROW(view >> u32_r, signum::message::deserialize_error);
+  BOOST_CHECK_EQUAL(view.position(), 12);
+  BOOST_CHECK_EQUAL(view.remaining(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(bulk_message_test)
+{
+  std::vector<float> f32(4096);
+  std::iota(f32.begin(), f32.end(), -100.5f);
+  const std::vector<int16_t> s16 = { -300, -5, 0, 7, 1000 };
+  const std::vector<uint8_t> bin(300, 0xab);
+  const std::string str(40, 'x');
+
+  signum::message msg;
+
+  BOOST_REQUIRE_NO_THROW(msg.serialize(f32.data(), f32.size()));
+  BOOST_REQUIRE_NO_THROW(msg.serialize_bin(bin.data(), bin.size()));
+  BOOST_REQUIRE_NO_THROW(msg << str << "abc");
+  BOOST_REQUIRE_NO_THROW(msg.serialize_map(1) << "key" << uint32_t(70000));
+
+  // An array of scalars serialized one at a time is read in bulk as well
+  BOOST_REQUIRE_NO_THROW(msg.serialize_array(s16.size()));
+  for (auto value : s16)
+    BOOST_REQUIRE_NO_THROW(msg << value);
+
+  std::vector<float> f32_r(f32.size());
+  BOOST_CHECK_THROW(msg.deserialize(f32_r.data(), f32_r.size() - 1),
+                    signum::message::deserialize_error);
+  BOOST_REQUIRE_NO_THROW(msg.deserialize(f32_r.data(), f32_r.size()));
+  BOOST_CHECK(f32_r == f32);
+
+  const uint8_t* bin_r = nullptr;
+  std::size_t bin_size = 0;
+  BOOST_REQUIRE_NO_THROW(msg.deserialize_bin(bin_r, bin_size));
+  BOOST_REQUIRE_EQUAL(bin_size, bin.size());
+  BOOST_CHECK_EQUAL_COLLECTIONS(bin_r, bin_r + bin_size, bin.begin(), bin.end());
+
+  std::string str_r, abc_r, key_r;
+  BOOST_REQUIRE_NO_THROW(msg >> str_r >> abc_r);
+  BOOST_CHECK_EQUAL(str_r, str);
+  BOOST_CHECK_EQUAL(abc_r, "abc");
+
+  std::size_t pairs = 0;
+  uint32_t u32_r = 0;
+  BOOST_REQUIRE_NO_THROW(msg.deserialize_map(pairs) >> key_r >> u32_r);
+  BOOST_CHECK_EQUAL(pairs, 1);
+  BOOST_CHECK_EQUAL(key_r, "key");
+  BOOST_CHECK_EQUAL(u32_r, 70000);
+
+  std::vector<int16_t> s16_r(s16.size());
+  BOOST_REQUIRE_NO_THROW(msg.deserialize(s16_r.data(), s16_r.size()));
+  BOOST_CHECK(s16_r == s16);
+}
+
+BOOST_AUTO_TEST_CASE(try_deserialize_test)
+{
+  signum::message msg;
+
+  msg << uint64_t(1) << uint32_t(70000) << int64_t(-5000000000) << 2.5;
+
+  // Values are rejected without advancing when they do not fit the type
+  uint16_t u16_r = 0;
+  uint64_t u64_r = 0;
+  int64_t s64_r = 0;
+  float f32_r = 0;
+  double f64_r = 0;
+  BOOST_CHECK(msg.try_deserialize(u16_r));
+  BOOST_CHECK_EQUAL(u16_r, 1);
+  BOOST_CHECK(!msg.try_deserialize(u16_r));
+  BOOST_CHECK(msg.try_deserialize(u64_r));
+  BOOST_CHECK_EQUAL(u64_r, 70000);
+  BOOST_CHECK(!msg.try_deserialize(u64_r));
+  BOOST_CHECK(msg.try_deserialize(s64_r));
+  BOOST_CHECK_EQUAL(s64_r, -5000000000);
+  BOOST_CHECK(!msg.try_deserialize(f32_r));
+  BOOST_CHECK_THROW(msg >> f32_r, signum::message::deserialize_error);
+  BOOST_CHECK(msg.try_deserialize(f64_r));
+  BOOST_CHECK_EQUAL(f64_r, 2.5);
+  BOOST_CHECK(!msg.try_deserialize(f64_r));
+}
+
+namespace
+{
+struct telemetry
+{
+  uint64_t time;
+  float power;
+  int16_t channel;
+  bool locked;
+  double frequency;
+};
+} // namespace (anonymous)
+
+SIGNUM_MESSAGE_FIELDS(telemetry, &telemetry::time, &telemetry::power,
+                      &telemetry::channel, &telemetry::locked, &telemetry::frequency)
+
+BOOST_AUTO_TEST_CASE(message_fields_test)
+{
+  static_assert(signum::message_size<telemetry>() == 1 + 9 + 5 + 3 + 1 + 9,
+                "size of described fields");
+
+  const telemetry tm = { 123456789012, -3.5f, -7, true, 915e6 };
+
+  signum::message msg;
+  BOOST_REQUIRE_NO_THROW(msg.serialize_fields(tm));
+
+  // The same fields encoded compactly are also accepted
+  BOOST_REQUIRE_NO_THROW(msg.serialize_array(5) << tm.time << tm.power
+                         << tm.channel << tm.locked << tm.frequency);
+  BOOST_REQUIRE_NO_THROW(msg.serialize_array(2) << tm.time << tm.power);
+
+  for (int n = 0; n < 2; ++n)
+  {
+    telemetry tm_r = { };
+    BOOST_REQUIRE_NO_THROW(msg.deserialize_fields(tm_r));
+    BOOST_CHECK_EQUAL(tm_r.time, tm.time);
+    BOOST_CHECK_EQUAL(tm_r.power, tm.power);
+    BOOST_CHECK_EQUAL(tm_r.channel, tm.channel);
+    BOOST_CHECK_EQUAL(tm_r.locked, tm.locked);
+    BOOST_CHECK_EQUAL(tm_r.frequency, tm.frequency);
+  }
+
+  telemetry tm_r = { };
+  BOOST_CHECK_THROW(msg.deserialize_fields(tm_r), signum::message::deserialize_error);
+}
+
+BOOST_AUTO_TEST_CASE(skip_test)
+{
+  const std::vector<float> block(100, 2.0f);
+  const std::vector<uint8_t> bin(70000, 1);
+
+  signum::message msg;
+
+  // A map holding nested containers, then a binary, a string and a number
+  msg.serialize_map(2) << "samples";
+  msg.serialize(block.data(), block.size());
+  msg << "nested";
+  msg.serialize_array(2).serialize_map(1) << 1 << true;
+  msg.serialize_array(0);
+  msg.serialize_bin(bin.data(), bin.size());
+  msg << std::string(300, 's') << 2.5;
+
+  const auto positions = msg.index();
+  BOOST_REQUIRE_EQUAL(positions.size(), 4);
+  BOOST_CHECK_EQUAL(positions[0], 0);
+  BOOST_CHECK_EQUAL(msg.index(2).size(), 2);
+
+  // Jump straight to the last object
+  double f64_r = 0;
+  BOOST_REQUIRE_NO_THROW(msg.seek(positions[3]) >> f64_r);
+  BOOST_CHECK_EQUAL(f64_r, 2.5);
+
+  // Skip each object in turn
+  std::string str_r;
+  BOOST_REQUIRE_NO_THROW(msg.seek(0).skip().skip().deserialize(str_r));
+  BOOST_CHECK_EQUAL(str_r, std::string(300, 's'));
+
+  // Extensions are skipped, and truncated objects leave the position alone
+  const uint8_t data[] = { 0xd4, 0x01, 0x02, 0xc7, 0x02, 0x05, 0xaa, 0xbb, 0x92, 0xc0 };
+  signum::message_view view(data, sizeof(data));
+  BOOST_REQUIRE_NO_THROW(view.skip().skip());
+  BOOST_CHECK_EQUAL(view.position(), 8);
+  BOOST_CHECK_THROW(view.skip(), signum::message::deserialize_error);
+  BOOST_CHECK_EQUAL(view.position(), 8);
+  BOOST_CHECK_THROW(view.seek(sizeof(data) + 1), signum::message::deserialize_error);
+}
+
+BOOST_AUTO_TEST_CASE(fixint_at_end_test)
+{
+  // A fixint in the last byte is decoded without reading past the view
+  std::unique_ptr<uint8_t[]> data(new uint8_t[1]);
+  data[0] = 0x07;
+
+  signum::message_view view(data.get(), 1);
+
+  uint64_t u64_r = 0;
+  BOOST_REQUIRE(view.try_deserialize(u64_r));
+  BOOST_CHECK_EQUAL(u64_r, 7);
+  BOOST_CHECK_EQUAL(view.remaining(), 0);
+}
@@ -6,6 +6,7 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
 
+#include <array>
 #include <cmath>
 
 #include "signum/oscillator.hpp"
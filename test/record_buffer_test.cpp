@@ -0,0 +1,91 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#define BOOST_TEST_MODULE record_buffer_test
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "signum/record_buffer.hpp"
+
+namespace cb = signum::circular_buffer;
+
+BOOST_AUTO_TEST_CASE(record_test)
+{
+  auto wr = cb::record_writer(4096);
+  auto rd = wr.make_reader();
+
+  BOOST_CHECK(rd.empty());
+  BOOST_CHECK(!rd.wait_for(std::chrono::milliseconds(1)));
+
+  // Records are filled in place and may be shorter than prepared
+  auto rec = wr.prepare(100);
+  BOOST_REQUIRE_EQUAL(rec.size(), 100);
+  std::iota(rec.begin(), rec.end(), 0);
+  BOOST_CHECK(rd.empty());
+  wr.commit(13);
+
+  const uint8_t data[] = { 1, 2, 3 };
+  wr.write(data, sizeof(data));
+  wr.write(nullptr, 0);
+
+  BOOST_REQUIRE(!rd.empty());
+  auto front = rd.front();
+  BOOST_REQUIRE_EQUAL(front.size(), 13);
+  BOOST_CHECK_EQUAL(front[12], 12);
+  rd.pop();
+
+  front = rd.front();
+  BOOST_CHECK_EQUAL_COLLECTIONS(front.begin(), front.end(),
+                                std::begin(data), std::end(data));
+  rd.pop();
+
+  BOOST_REQUIRE(!rd.empty());
+  BOOST_CHECK(rd.front().empty());
+  rd.pop();
+  BOOST_CHECK(rd.empty());
+
+  BOOST_CHECK_THROW(wr.prepare(wr.max_record_size() + 1), std::length_error);
+  wr.prepare(10);
+  BOOST_CHECK_THROW(wr.commit(17), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(threaded_record_test)
+{
+  auto wr = cb::record_writer(4096);
+  auto rd = wr.make_reader();
+
+  // Records of every length wrap around the buffer many times
+  const size_t count = 2000;
+  std::thread producer([&]{
+    for (size_t n = 0; n < count; ++n)
+    {
+      const auto size = n % 1000;
+      auto rec = wr.prepare(size);
+      std::fill(rec.begin(), rec.end(), static_cast<uint8_t>(n));
+      wr.commit(size);
+    }
+  });
+
+  bool intact = true;
+  for (size_t n = 0; n < count; ++n)
+  {
+    rd.wait();
+    const auto rec = rd.front();
+    intact = intact && rec.size() == n % 1000 &&
+             std::all_of(rec.begin(), rec.end(),
+                         [n](uint8_t x) { return x == static_cast<uint8_t>(n); });
+    rd.pop();
+  }
+  producer.join();
+
+  BOOST_CHECK(intact);
+  BOOST_CHECK(rd.empty());
+}
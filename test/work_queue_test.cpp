@@ -0,0 +1,111 @@
+/*
+ * Copyright 2016 C. Brett Witherspoon
+ */
+
+#define BOOST_TEST_MODULE work_queue_test
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "signum/work_queue.hpp"
+
+namespace cb = signum::circular_buffer;
+
+BOOST_AUTO_TEST_CASE(work_queue_test)
+{
+  cb::work_queue<int> queue(1023);
+
+  // Blocks are claimed in order and committed in the order claimed
+  auto first = queue.acquire_write(10);
+  auto second = queue.acquire_write(20);
+  BOOST_CHECK_EQUAL(first.index(), 0);
+  BOOST_CHECK_EQUAL(second.index(), 10);
+  BOOST_CHECK_EQUAL(second.begin() - first.begin(), 10);
+
+  std::fill(first.begin(), first.end(), 1);
+  std::fill(second.begin(), second.end(), 2);
+
+  // A later block waits for the one before it to commit
+  std::thread committer([&]{ queue.commit_write(second); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  BOOST_CHECK(queue.try_acquire_read(1).empty());
+  queue.commit_write(first);
+  committer.join();
+
+  // Consumers take whole blocks only
+  BOOST_CHECK(queue.try_acquire_read(31).empty());
+  auto block = queue.try_acquire_read(30);
+  BOOST_REQUIRE_EQUAL(block.size(), 30);
+  BOOST_CHECK_EQUAL(block.begin()[9], 1);
+  BOOST_CHECK_EQUAL(block.begin()[10], 2);
+  queue.commit_read(block);
+
+  BOOST_CHECK(queue.acquire_read_for(1, std::chrono::milliseconds(1)).empty());
+
+  // A timeout past the end of the clock waits without a deadline
+  std::thread producer([&]{
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queue.commit_write(queue.acquire_write(1));
+  });
+  block = queue.acquire_read_for(1, std::chrono::nanoseconds::max());
+  BOOST_CHECK_EQUAL(block.size(), 1);
+  queue.commit_read(block);
+  producer.join();
+  BOOST_CHECK_EQUAL(queue.try_acquire_write(queue.max_size()).size(), queue.max_size());
+  BOOST_CHECK_THROW(queue.acquire_write(queue.max_size() + 1), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(threaded_work_queue_test)
+{
+  cb::work_queue<size_t> queue(4095);
+
+  const size_t producers = 3;
+  const size_t consumers = 3;
+  const size_t block = 64;
+  const size_t blocks = 2000;
+
+  // Each item holds its absolute index, so any overlap or reordering of
+  // blocks is seen by the consumers
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < producers; ++p)
+  {
+    threads.emplace_back([&]{
+      for (size_t n = 0; n < blocks; ++n)
+      {
+        auto blk = queue.acquire_write(block);
+        for (size_t i = 0; i < blk.size(); ++i)
+          blk.begin()[i] = blk.index() + i;
+        queue.commit_write(blk);
+      }
+    });
+  }
+
+  std::atomic<size_t> consumed(0);
+  std::atomic<bool> ordered(true);
+  for (size_t c = 0; c < consumers; ++c)
+  {
+    threads.emplace_back([&]{
+      for (size_t n = 0; n < producers * blocks / consumers; ++n)
+      {
+        auto blk = queue.acquire_read(block);
+        for (size_t i = 0; i < blk.size(); ++i)
+          if (blk.begin()[i] != blk.index() + i)
+            ordered = false;
+        consumed += blk.size();
+        queue.commit_read(blk);
+      }
+    });
+  }
+
+  for (auto & thread : threads)
+    thread.join();
+
+  BOOST_CHECK(ordered);
+  BOOST_CHECK_EQUAL(consumed, producers * blocks * block);
+  BOOST_CHECK(queue.try_acquire_read(1).empty());
+}